@@ -15,15 +15,16 @@ import { useEffect, useState } from 'react'
 const pushButton = (_web_button: number) => {}
 
 export const CentaurScreen = () => {
-  const [timestamp, setTimestamp] = useState(new Date().getTime())
-  const imageUrl = `/api/screen?${timestamp}`
+  // Server revalidates by ETag, so the same generation is never downloaded twice
+  const [generation, setGeneration] = useState(0)
+  const imageUrl = `/api/screen?generation=${generation}`
 
   useEffect(() => {
-    const updated = (_event: MessageEvent) => {
-      setTimestamp(new Date().getTime())
+    const updated = (event: MessageEvent) => {
+      setGeneration(JSON.parse(event.data).generation)
     }
-    events.addEventListener('screen', updated)
-    return () => events.removeEventListener('screen', updated)
+    events.addEventListener('screen_changed', updated)
+    return () => events.removeEventListener('screen_changed', updated)
   }, [])
 
   return (
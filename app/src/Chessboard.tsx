@@ -6,6 +6,7 @@ import '@chrisoakman/chessboardjs/dist/chessboard-1.0.0.js'
 
 import './Chessboard.css'
 import { ChessboardArrows } from './ChessboardArrows'
+import { events } from './events'
 import { pieceTheme } from './pieces'
 import { useAppDispatch, useAppSelector } from './store/hooks'
 import { useCallback, useEffect, useRef } from 'react'
@@ -35,6 +36,16 @@ export const Chessboard = ({ style }) => {
     })()
   }, [])
 
+  // Moves arrive with the position they reach
+  useEffect(() => {
+    const changed = (event: MessageEvent) => {
+      const { fen } = JSON.parse(event.data)
+      dispatch(history.setCurrentFEN(fen))
+    }
+    events.addEventListener('game_changed', changed)
+    return () => events.removeEventListener('game_changed', changed)
+  }, [])
+
   useEffect(() => {
     const currentBoard = board.current
     const resizeObserver = new ResizeObserver(() => {
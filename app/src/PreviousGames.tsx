@@ -2,25 +2,44 @@
 // See license at end of file
 
 import { useAppDispatch } from './store/hooks'
-import { useState } from 'react'
+import { useEffect, useState } from 'react'
 import * as board from './store/boardSlice'
 import * as display from './store/displaySlice'
 
 type Game = {
   black: string
-  created_at: string
+  date: string
   event: string
   id: number
   result: string
   round: string
   site: string
-  source: string
   white: string
 }
 
+type Page = {
+  games: Game[]
+  next: number | null
+}
+
 export const PreviousGames = () => {
   const dispatch = useAppDispatch()
   const [games, setGames] = useState<Game[]>([])
+  const [next, setNext] = useState<number | null>(null)
+
+  const loadPage = async (before: number | null) => {
+    const response = await fetch(before ? `/api/games?before=${before}` : '/api/games')
+    if (!response.ok) {
+      return
+    }
+    const page: Page = await response.json()
+    setGames((games) => (before ? [...games, ...page.games] : page.games))
+    setNext(page.next)
+  }
+
+  useEffect(() => {
+    loadPage(null)
+  }, [])
 
   const loadGame = (_id: number) => {
     dispatch(board.setSynchronized(false))
@@ -34,7 +53,7 @@ export const PreviousGames = () => {
   return (
     <div className="bg-base-100 h-full overflow-y-auto z-20">
       <ul className="menu">
-        {games.map(({ black, created_at, id, result, white }) => (
+        {games.map(({ black, date, id, result, white }) => (
           <li key={id}>
             <div>
               <button
@@ -47,11 +66,18 @@ export const PreviousGames = () => {
                 <h3 className="font-bold">
                   {white} vs. {black} {result}
                 </h3>
-                {created_at}
+                {date}
               </div>
             </div>
           </li>
         ))}
+        {next && (
+          <li>
+            <button className="btn btn-ghost btn-sm" onClick={() => loadPage(next)}>
+              More
+            </button>
+          </li>
+        )}
       </ul>
     </div>
   )
@@ -3,7 +3,12 @@ import react from '@vitejs/plugin-react'
 import viteCompression from 'vite-plugin-compression'
 
 export default defineConfig({
-  plugins: [react(), viteCompression({ algorithm: 'brotliCompress' })],
+  // httpd serves .br or .gz in place of the original, as the browser accepts
+  plugins: [
+    react(),
+    viteCompression({ algorithm: 'brotliCompress' }),
+    viteCompression({ algorithm: 'gzip' }),
+  ],
   server: {
     proxy: {
       '/api': 'http://localhost:8080',
@@ -0,0 +1,224 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Benchmark for rendering a full frame, a board of sprites and a screenful of
+// moves, as on every move.  Compares Context, which copies whole rows of bits,
+// against the previous approach of transforming and setting each pixel in
+// turn.  Frames are drawn both aligned and offset by a few pixels, unrotated
+// and rotated 180 degrees as on the board, where sprites are also drawn from
+// the pre-rotated atlas.  Exits with failure if the approaches don't draw the
+// same image.
+//
+// usage: blit_bench [iterations] [pieces.bmp]
+
+#include "../src/graphics.h"
+#include "../src/image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+// Previous implementation, for comparison
+struct PixelContext {
+    Image*       image;
+    Rotate       rotate;
+    const sFONT* font{&Font16};
+
+    void setpixel(int x, int y, PixelColor color) {
+        if (rotate == ROTATE_180) {
+            x = image->width  - 1 - x;
+            y = image->height - 1 - y;
+        }
+        if (x < 0 || image->width <= x || y < 0 || image->height <= y) {
+            return;
+        }
+        const int byte = y * image->width_bytes + x / 8;
+        const int bit  = 0x80 >> (x % 8);
+        if (color == PIXEL_BLACK) {
+            image->data_[byte] &= ~bit;
+        } else {
+            image->data_[byte] |=  bit;
+        }
+    }
+
+    void clear() {
+        memset(image->data(), PIXEL_WHITE, image->size_bytes);
+    }
+
+    void drawchar(int x, int y, char c) {
+        auto index = (c - ' ') * font->Height * (font->Width / 8 + (font->Width % 8 ? 1 : 0));
+        auto ptr = &font->table[index];
+        for (auto r = 0; r < font->Height; ++r) {
+            for (auto c = 0; c < font->Width; ++c) {
+                setpixel(x + c, y + r, *ptr & (0x80 >> (c % 8)) ? PIXEL_BLACK : PIXEL_WHITE);
+                if (c % 8 == 7) {
+                    ptr++;
+                }
+            }
+            if (font->Width % 8 != 0) {
+                ptr++;
+            }
+        }
+    }
+
+    void drawstring(int left, int top, const char* s) {
+        for (auto x = left; *s; x += font->Width) {
+            drawchar(x, top, *s++);
+        }
+    }
+
+    void drawimage(int x_to, int y_to, const Image& source, int x_from, int y_from, int w, int h) {
+        for (auto y = 0; y < h; ++y) {
+            for (auto x = 0; x < w; ++x) {
+                const auto x_src = x_from + x;
+                const auto y_src = y_from + y;
+                if (x_src < 0 || source.width <= x_src || y_src < 0 || source.height <= y_src) {
+                    continue;
+                }
+                const auto byte = source.data_[y_src * source.width_bytes + x_src / 8];
+                setpixel(x_to + x, y_to + y, byte & (0x80 >> (x_src % 8)) ? PIXEL_WHITE : PIXEL_BLACK);
+            }
+        }
+    }
+};
+
+static const char* BOARD[8] = {
+    "r bq rk ",
+    "  pnbppp",
+    "p  p n  ",
+    "npp p   ",
+    "   PP   ",
+    "  P  N P",
+    "PPB  PP ",
+    "RNBQR K ",
+};
+
+static const char* MOVES[] = {
+    "1. e4 e5",
+    "2. Nf3 Nc6",
+    "3. Bb5 a6",
+    "4. Ba4 Nf6",
+    "5. O-O Be7",
+    "6. Re1 b5",
+    "7. Bb3 d6",
+    "8. c3 O-O",
+    "9. h3 Na5",
+    "10. Bc2 c5",
+};
+
+// Draw sprites from pieces, or from atlas if given
+template <typename C>
+static void render(C& context, const Image& pieces, int offset, const Atlas* atlas = nullptr) {
+    const auto sprites     = " PRNBQKprnbqk?! ";
+    const auto square_size = 16;
+
+    context.clear();
+    for (auto r = 0; r != 8; ++r) {
+        for (auto c = 0; c != 8; ++c) {
+            const auto sprite = strchr(sprites, BOARD[r][c]);
+            const auto x_src  = (sprite - sprites) * square_size;
+            const auto y_src  = (r + c) % 2 ? square_size : 0;
+            const auto x_dst  = offset + c * square_size;
+            const auto y_dst  = offset + r * square_size;
+            if constexpr (is_same_v<C, Context>) {
+                if (atlas) {
+                    context.drawatlas(x_dst, y_dst, *atlas, x_src, y_src, square_size, square_size);
+                    continue;
+                }
+            }
+            context.drawimage(x_dst, y_dst, pieces, x_src, y_src, square_size, square_size);
+        }
+    }
+
+    auto top = 128 + offset;
+    for (auto line : MOVES) {
+        context.drawstring(offset, top, line);
+        top += context.font->Height;
+    }
+}
+
+template <typename F>
+static double measure(long iterations, F f) {
+    // Warm up
+    f();
+
+    const auto started = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        f();
+    }
+    const auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - started);
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 1000;
+    const char* path      = argc > 2 ? argv[2] : "assets/pieces.bmp";
+
+    const auto pieces = Image::readbmp(path);
+    if (!pieces) {
+        fprintf(stderr, "%s: failed to load %s\n", argv[0], path);
+        return EXIT_FAILURE;
+    }
+
+    auto ok = true;
+    for (auto rotate : {ROTATE_0, ROTATE_180}) {
+        for (auto offset : {0, 3}) {
+            printf("rotate %d, offset %d\n", rotate, offset);
+
+            Image expected{128, 296};
+            PixelContext pixel_context{&expected, rotate};
+            const auto pixel_us = measure(iterations, [&]() {
+                render(pixel_context, *pieces, offset);
+            });
+
+            Image actual{128, 296};
+            Context context;
+            context.image  = &actual;
+            context.rotate = rotate;
+            const auto blit_us = measure(iterations, [&]() {
+                render(context, *pieces, offset);
+            });
+
+            printf("  %-8s %10.1f us/frame\n", "pixel", pixel_us);
+            printf("  %-8s %10.1f us/frame\n", "blit",  blit_us);
+            if (actual != expected) {
+                printf("  images differ\n");
+                ok = false;
+            }
+
+            if (rotate == PIECES_ATLAS.rotate) {
+                Image atlas_image{128, 296};
+                context.image = &atlas_image;
+                const auto atlas_us = measure(iterations, [&]() {
+                    render(context, *pieces, offset, &PIECES_ATLAS);
+                });
+                printf("  %-8s %10.1f us/frame\n", "atlas", atlas_us);
+                if (atlas_image != expected) {
+                    printf("  atlas image differs\n");
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
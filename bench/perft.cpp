@@ -0,0 +1,283 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Perft: count leaf nodes of the legal move tree to a fixed depth.  Counts for
+// the standard test positions are well known, so this is both a correctness
+// check and a throughput measurement for the move generator.
+//
+// usage: perft [-d depth] [-v] [-r] [-s stockfish] [fen]
+//
+//   -d depth      search depth (default 4)
+//   -v            divide: print node count below each root move
+//   -r            use reference generator (gen) rather than movegen
+//   -s stockfish  cross-check node counts against UCI engine
+//   fen           position to search (default is standard suite)
+
+#include "../src/chess/chess_uci.h"
+#include "../src/thc/gen.h"
+#include "../src/thc/movegen.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace thc;
+
+struct Suite {
+    const char*  name;
+    const char*  fen;
+    vector<long> expected;  // Node count at depth 1, 2, ...
+};
+
+static const Suite SUITE[] = {
+    {"start",
+     "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609, 119060324}},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603, 193690690}},
+    {"position3",
+     "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 11030083, 178633661}},
+    {"position4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333, 15833292}},
+    {"position5",
+     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487, 89941194}},
+    {"position6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     {46, 2079, 89890, 3894594, 164075551}},
+};
+
+static bool use_reference = false;
+
+static vector<Move> legal_moves(const ChessPosition& position) {
+    return use_reference
+        ? gen::GenLegalMoveList(position)
+        : movegen::GenLegalMoveList(position);
+}
+
+static long perft(const ChessPosition& position, int depth) {
+    if (depth <= 0) {
+        return 1;
+    }
+
+    const auto moves = legal_moves(position);
+    if (depth == 1) {
+        return moves.size();
+    }
+
+    long nodes = 0;
+    for (const auto& move : moves) {
+        nodes += perft(position.play_move(move), depth - 1);
+    }
+    return nodes;
+}
+
+static map<string, long> divide(const ChessPosition& position, int depth) {
+    map<string, long> result;
+    for (const auto& move : legal_moves(position)) {
+        result[move.uci()] = perft(position.play_move(move), depth - 1);
+    }
+    return result;
+}
+
+// Wait for engine to acknowledge UCI handshake
+static bool engine_ready(UCIEngine* engine) {
+    const auto timeout = chrono::steady_clock::now() + chrono::seconds(10);
+    while (chrono::steady_clock::now() < timeout) {
+        if (engine->receive()) {
+            return true;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return false;
+}
+
+// Run perft in external engine, nullptr if unavailable
+static unique_ptr<UCIPerftMessage>
+engine_perft(UCIEngine* engine, const char* fen, int depth) {
+    if (!engine) {
+        return nullptr;
+    }
+
+    auto request = make_unique<UCIPerftMessage>(fen, depth);
+    auto pending = request.get();
+    engine->send(std::move(request));
+
+    const auto timeout = chrono::steady_clock::now() + chrono::minutes(10);
+    while (chrono::steady_clock::now() < timeout) {
+        if (auto response = engine->receive()) {
+            if (response.get() == pending) {
+                return unique_ptr<UCIPerftMessage>(
+                    static_cast<UCIPerftMessage*>(response.release()));
+            }
+            continue;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return nullptr;
+}
+
+// Report differences between our divide and engine's, returns true if same
+static bool compare(const map<string, long>& ours, const map<string, long>& theirs) {
+    auto same = true;
+    for (const auto& [uci, nodes] : ours) {
+        auto p = theirs.find(uci);
+        if (p == theirs.end()) {
+            printf("  %-6s %10ld  (illegal according to engine)\n", uci.data(), nodes);
+            same = false;
+        }
+        else if (p->second != nodes) {
+            printf("  %-6s %10ld  engine %ld\n", uci.data(), nodes, p->second);
+            same = false;
+        }
+    }
+    for (const auto& [uci, nodes] : theirs) {
+        if (ours.find(uci) == ours.end()) {
+            printf("  %-6s %10s  (missing, engine %ld)\n", uci.data(), "", nodes);
+            same = false;
+        }
+    }
+    return same;
+}
+
+// Search one position, returns false on any mismatch
+static bool run(const char* name,
+                const char* fen,
+                int         depth,
+                long        expected,
+                bool        show_divide,
+                UCIEngine*  engine)
+{
+    ChessPosition position;
+    if (!position.Forsyth(fen)) {
+        fprintf(stderr, "%s: invalid FEN: %s\n", name, fen);
+        return false;
+    }
+
+    const auto started = chrono::steady_clock::now();
+    const auto moves   = divide(position, depth);
+    const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - started);
+
+    long nodes = 0;
+    for (const auto& [uci, count] : moves) {
+        nodes += count;
+    }
+    if (depth <= 0) {
+        nodes = 1;
+    }
+
+    if (show_divide) {
+        for (const auto& [uci, count] : moves) {
+            printf("  %-6s %10ld\n", uci.data(), count);
+        }
+    }
+
+    const auto nps = elapsed.count() > 0 ? nodes / elapsed.count() : 0.0;
+    printf("%-10s depth %d  nodes %12ld  %8.3f s  %12.0f nps",
+           name, depth, nodes, elapsed.count(), nps);
+
+    auto ok = true;
+    if (expected >= 0 && nodes != expected) {
+        printf("  FAIL expected %ld", expected);
+        ok = false;
+    }
+    printf("\n");
+
+    if (auto response = engine_perft(engine, fen, depth)) {
+        if (response->nodes < 0) {
+            printf("%-10s engine failed\n", name);
+            ok = false;
+        }
+        else if (response->nodes != nodes || !compare(moves, response->divide)) {
+            printf("%-10s engine disagrees: %ld nodes\n", name, response->nodes);
+            ok = false;
+        }
+    }
+    else if (engine) {
+        printf("%-10s engine did not respond\n", name);
+        ok = false;
+    }
+
+    return ok;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [-d depth] [-v] [-r] [-s stockfish] [fen]\n", argv0);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    int   depth       = 4;
+    bool  show_divide = false;
+    char* stockfish   = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:vrs:")) != -1) {
+        switch (opt) {
+        case 'd': depth = atoi(optarg);   break;
+        case 'v': show_divide = true;     break;
+        case 'r': use_reference = true;   break;
+        case 's': stockfish = optarg;     break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (argc - optind > 1) {
+        usage(argv[0]);
+    }
+
+    shared_ptr<UCIEngine> engine;
+    if (stockfish) {
+        // Engine may exit before handshake, report that rather than dying
+        signal(SIGPIPE, SIG_IGN);
+        engine = UCIEngine::execvp(stockfish, {stockfish});
+        if (!engine || !engine_ready(engine.get())) {
+            fprintf(stderr, "%s: cannot run %s\n", argv[0], stockfish);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Build any lazily-initialized lookup tables before timing
+    (void)legal_moves(ChessPosition{});
+
+    auto ok = true;
+    if (optind < argc) {
+        ok = run("fen", argv[optind], depth, -1, show_divide, engine.get());
+    }
+    else {
+        for (const auto& suite : SUITE) {
+            const auto expected =
+                0 < depth && size_t(depth) <= suite.expected.size()
+                ? suite.expected[depth - 1]
+                : -1;
+            ok = run(suite.name, suite.fen, depth, expected, show_divide, engine.get()) && ok;
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
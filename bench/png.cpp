@@ -0,0 +1,145 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Benchmark for encoding the display image as PNG, which is served to every
+// web client watching the screen.  Renders a typical frame, a board and a few
+// lines of moves, then compares the specialised encoder with libpng for time
+// and size.  Exits with failure if the two don't decode to the same image.
+//
+// usage: png_bench [iterations] [pieces.bmp]
+
+#include "../src/graphics.h"
+#include "../src/image.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <png.h>
+
+using namespace std;
+
+static const char* BOARD[8] = {
+    "rnbqkb r",
+    "pp p ppp",
+    "     n  ",
+    "  pp    ",
+    "   PP   ",
+    "  N     ",
+    "PP   PPP",
+    "R BQKBNR",
+};
+
+static const char* MOVES[] = {
+    "1. d4 Nf6",
+    "2. c4 e6",
+    "3. Nc3 d5",
+    "4. e4 c5",
+};
+
+static void render(Context& context, const Image& pieces) {
+    const auto sprites     = " PRNBQKprnbqk?! ";
+    const auto square_size = 16;
+
+    context.clear();
+    for (auto r = 0; r != 8; ++r) {
+        for (auto c = 0; c != 8; ++c) {
+            const auto sprite = strchr(sprites, BOARD[r][c]);
+            const auto x_src  = (sprite - sprites) * square_size;
+            const auto y_src  = (r + c) % 2 ? square_size : 0;
+            context.drawimage(
+                c * square_size, r * square_size, pieces, x_src, y_src, square_size, square_size);
+        }
+    }
+
+    auto top = 128;
+    for (auto line : MOVES) {
+        context.drawstring(0, top, line);
+        top += context.font->Height;
+    }
+}
+
+static bool decode(const uint8_t* png, size_t size, vector<uint8_t>& pixels) {
+    png_image image{};
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&image, png, size)) {
+        return false;
+    }
+    image.format = PNG_FORMAT_GRAY;
+    pixels.resize(PNG_IMAGE_SIZE(image));
+    return png_image_finish_read(&image, NULL, pixels.data(), 0, NULL);
+}
+
+template <typename F>
+static double measure(long iterations, F f) {
+    // Warm up
+    f();
+
+    const auto started = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        f();
+    }
+    const auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - started);
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 1000;
+    const char* path      = argc > 2 ? argv[2] : "assets/pieces.bmp";
+
+    const auto pieces = Image::readbmp(path);
+    if (!pieces) {
+        fprintf(stderr, "%s: failed to load %s\n", argv[0], path);
+        return EXIT_FAILURE;
+    }
+
+    Image image{128, 296};
+    Context context;
+    context.image = &image;
+    render(context, *pieces);
+
+    uint8_t* libpng_png  = NULL;
+    size_t   libpng_size = 0;
+    const auto libpng_us = measure(iterations, [&]() {
+        free(libpng_png);
+        libpng_png  = NULL;
+        libpng_size = 0;
+        (void)image.png(&libpng_png, &libpng_size);
+    });
+
+    vector<uint8_t> fast_png(image.png_bound());
+    size_t fast_size = 0;
+    const auto fast_us = measure(iterations, [&]() {
+        fast_size = image.png(fast_png.data(), fast_png.size());
+    });
+
+    printf("  %-8s %10.1f us/frame  %6zu bytes\n", "libpng", libpng_us, libpng_size);
+    printf("  %-8s %10.1f us/frame  %6zu bytes\n", "fast",   fast_us,   fast_size);
+
+    vector<uint8_t> expected, actual;
+    const auto ok =
+        decode(libpng_png, libpng_size, expected) &&
+        decode(fast_png.data(), fast_size, actual) &&
+        expected == actual;
+    free(libpng_png);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,141 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Micro-benchmark for Position::read_move, which runs on every board poll
+// while a piece is in the air.  Reports time and heap allocations per call,
+// alongside the previous approach of allocating a shared Position for each
+// candidate.  Exits with failure if read_move allocates.
+//
+// usage: read_move_bench [iterations]
+
+#include "../src/chess/chess_position.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace thc;
+
+static long allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (auto p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// Previous implementation, for comparison
+static bool shared_read_move(const Position& position, Bitmap boardstate) {
+    auto maybe_valid = false;
+    for (auto move : position.legal_moves()) {
+        const auto after = position.apply_move(move);
+        if (after->bitmap() != boardstate) {
+            maybe_valid = maybe_valid || position.incomplete(boardstate, *after);
+            continue;
+        }
+        return true;
+    }
+    return maybe_valid;
+}
+
+struct Sample {
+    const char* name;
+    const char* fen;
+    Square      lift;   // Piece in the air
+    Square      place;  // Where it lands, or SQUARE_INVALID if still in hand
+};
+
+static const Sample SAMPLES[] = {
+    {"opening, lifted",
+     "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+     f1, SQUARE_INVALID},
+    {"opening, placed",
+     "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+     f1, c4},
+    {"middlegame, lifted",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     f3, SQUARE_INVALID},
+    {"middlegame, placed",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     f3, h4},
+};
+
+template <typename F>
+static void measure(const char* label, long iterations, double& ns, double& allocs, F f) {
+    // Warm up, e.g., reusable storage
+    f();
+
+    const auto before  = allocations;
+    const auto started = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        f();
+    }
+    const auto elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - started);
+
+    ns     = elapsed.count() / iterations;
+    allocs = double(allocations - before) / iterations;
+    printf("  %-8s %10.0f ns/call  %8.2f allocations/call\n", label, ns, allocs);
+}
+
+int main(int argc, char* argv[]) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 20000;
+
+    auto ok = true;
+    for (const auto& sample : SAMPLES) {
+        const Position position{sample.fen};
+
+        auto boardstate = position.bitmap() & ~(Bitmap{1} << sample.lift);
+        if (sample.place != SQUARE_INVALID) {
+            boardstate |= Bitmap{1} << sample.place;
+        }
+
+        printf("%s\n", sample.name);
+
+        ActionHistory actions{lift(sample.lift)};
+        if (sample.place != SQUARE_INVALID) {
+            actions.push_back(place(sample.place));
+        }
+
+        MoveList candidates;
+        double ns, allocs;
+        measure("read", iterations, ns, allocs, [&]() {
+            (void)position.read_move(boardstate, actions, candidates);
+        });
+        if (allocs > 0) {
+            ok = false;
+        }
+
+        measure("shared", iterations, ns, allocs, [&]() {
+            (void)shared_read_move(position, boardstate);
+        });
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,209 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Benchmark for rendering a game on the board's display, all the way through
+// Centaur and Screen to the virtual e-Paper display.  The game is first played
+// move by move, waiting for each move to be shown, to report the size of
+// display updates and to compare each frame shown against golden images.  It
+// is then replayed as fast as possible to report frames rendered per second.
+// Exits with failure if any frame differs from golden.
+//
+// usage: render_bench [iterations] [golden.pbm]
+//
+// Golden images are written to golden.pbm if it doesn't exist, so delete it to
+// accept a change in rendering.
+
+#include "../src/centaur.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+
+using Frame = vector<uint8_t>;
+
+static const char* MOVES[] = {
+    "e4", "e5", "Nf3", "Nc6", "Bb5", "a6", "Ba4", "Nf6", "O-O", "Be7",
+    "Re1", "b5", "Bb3", "d6", "c3", "O-O", "h3", "Nb8", "d4", "Nbd7",
+    "c4", "c6", "cxb5", "axb5", "Nc3", "Bb7", "Bg5", "b4", "Nb1", "h6",
+    "Bh4", "c5", "dxe5", "Nxe4", "Bxe7", "Qxe7", "exd6", "Qf6", "Nbd2", "Nxd6",
+    "Nc4", "Nxc4", "Bxc4", "Nb6", "Ne5", "Rae8",
+};
+
+static const auto FRAME_BYTES = (SCREEN_WIDTH + 7) / 8 * SCREEN_HEIGHT;
+
+// PBM is 1 for black, where we're 1 for white
+static vector<Frame> read_pbm(const char* path) {
+    vector<Frame> frames;
+    auto in = fopen(path, "rb");
+    if (!in) {
+        return frames;
+    }
+    char line[256];
+    while (fgets(line, sizeof line, in)) {
+        // P4, comments, then dimensions
+        if (line[0] == 'P' || line[0] == '#') {
+            continue;
+        }
+        int width, height;
+        if (sscanf(line, "%d %d", &width, &height) != 2
+            || width != SCREEN_WIDTH || height != SCREEN_HEIGHT)
+        {
+            break;
+        }
+        Frame frame(FRAME_BYTES);
+        if (fread(frame.data(), 1, frame.size(), in) != frame.size()) {
+            break;
+        }
+        for (auto& byte : frame) {
+            byte = ~byte;
+        }
+        frames.push_back(move(frame));
+    }
+    fclose(in);
+    return frames;
+}
+
+static bool write_pbm(const char* path, const vector<Frame>& frames) {
+    auto out = fopen(path, "wb");
+    if (!out) {
+        return false;
+    }
+    for (size_t i = 0; i < frames.size(); ++i) {
+        fprintf(out, "P4\n# ply %zu\n%d %d\n", i, SCREEN_WIDTH, SCREEN_HEIGHT);
+        for (auto byte : frames[i]) {
+            fputc(~byte & 0xff, out);
+        }
+    }
+    return fclose(out) == 0;
+}
+
+static long changed_pixels(const Frame& a, const Frame& b) {
+    long n = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        n += __builtin_popcount((a[i] ^ b[i]) & 0xff);
+    }
+    return n;
+}
+
+// Wait for display to catch up with screen, and return what it shows
+static Frame shown(size_t& seen) {
+    auto& screen = centaur.screen;
+    const auto expected = screen.frame(SCREEN_RAW)->data;
+
+    const auto deadline = chrono::steady_clock::now() + chrono::seconds(1);
+    while (chrono::steady_clock::now() < deadline) {
+        const auto records = screen.epd2in9d.records();
+        for (auto r = records.rbegin(); r != records.rend(); ++r) {
+            if (!r->image.empty()) {
+                if (r->image == expected) {
+                    return r->image;
+                }
+                break;
+            }
+        }
+        seen = screen.epd2in9d.wait_frames(seen, chrono::milliseconds(100));
+    }
+    return {};
+}
+
+int main(int argc, char* argv[]) {
+    const long iterations = argc > 1 ? atol(argv[1]) : 100;
+    const char* golden_path = argc > 2 ? argv[2] : nullptr;
+
+    auto& display = centaur.screen.epd2in9d;
+    auto ok = true;
+
+    // Play once, showing every move
+    const auto started = chrono::steady_clock::now();
+    size_t seen = 0;
+    vector<Frame> frames;
+    centaur.render();
+    frames.push_back(shown(seen));
+    for (auto san : MOVES) {
+        centaur.game->play_san_move(san);
+        frames.push_back(shown(seen));
+    }
+
+    long updates = 0, full = 0, rows = 0, changed = 0;
+    for (const auto& record : display.records()) {
+        if (record.time < started || record.image.empty()) {
+            continue;
+        }
+        ++updates;
+        full    += record.kind == EpdRecord::DISPLAY;
+        rows    += record.bottom - record.top;
+        changed += record.changed_bytes;
+    }
+    printf("display\n");
+    printf("  %-8s %10ld (%ld full)\n", "updates", updates, full);
+    if (updates) {
+        const auto width_bytes = (SCREEN_WIDTH + 7) / 8;
+        printf("  %-8s %10.1f bytes/update\n", "sent",    double(rows) * width_bytes / updates);
+        printf("  %-8s %10.1f bytes/update\n", "changed", double(changed) / updates);
+    }
+
+    if (golden_path) {
+        const auto golden = read_pbm(golden_path);
+        if (golden.empty()) {
+            printf("golden\n  writing %s\n", golden_path);
+            if (!write_pbm(golden_path, frames)) {
+                perror(golden_path);
+                ok = false;
+            }
+        } else {
+            printf("golden\n");
+            long differ = 0;
+            for (size_t i = 0; i < frames.size(); ++i) {
+                if (frames[i].empty()) {
+                    printf("  ply %zu not shown\n", i);
+                    ++differ;
+                } else if (i >= golden.size()) {
+                    printf("  ply %zu missing from golden\n", i);
+                    ++differ;
+                } else if (const auto n = changed_pixels(frames[i], golden[i])) {
+                    printf("  ply %zu differs in %ld pixels\n", i, n);
+                    ++differ;
+                }
+            }
+            printf("  %-8s %10zu frames, %ld differ\n", "compared", frames.size(), differ);
+            ok = ok && differ == 0;
+        }
+    }
+
+    // Replay as fast as possible
+    const auto replay_started = chrono::steady_clock::now();
+    for (long i = 0; i < iterations; ++i) {
+        centaur.set_game(make_unique<Game>());
+        centaur.render();
+        for (auto san : MOVES) {
+            centaur.game->play_san_move(san);
+        }
+    }
+    const auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - replay_started);
+    const auto rendered = iterations * (1 + size(MOVES));
+    printf("render\n");
+    if (rendered) {
+        printf("  %-8s %10.1f us/frame\n", "render", elapsed.count() * 1e6 / rendered);
+        printf("  %-8s %10.1f frames/s\n", "rate", rendered / elapsed.count());
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,48 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+#pragma once
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include "fonts/fonts.h"
+
+#include <cstdint>
+
+// Sprites and font glyphs, prepared at build time by make_atlas so that they
+// can be copied straight to the screen.  The atlas is laid out like an Image,
+// as a grid of equally sized cells, but each cell is rotated in place to match
+// the screen, and a set bit is background, for fonts as for sprites.
+struct Atlas {
+    const std::uint8_t* data;
+    int width;
+    int height;
+    int width_bytes;
+    int rotate;       // Degrees CCW, as Rotate
+    int cell_width;
+    int cell_height;
+};
+
+// Chess pieces on light and dark squares, from assets/pieces.bmp
+extern const Atlas PIECES_ATLAS;
+
+// Glyphs ' ' through '~', one cell each, top to bottom.  Null if font has no
+// atlas.
+const Atlas* font_atlas(const sFONT* font);
+
+#endif
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
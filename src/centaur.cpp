@@ -4,10 +4,13 @@
 #include "centaur.h"
 #include "cfg.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace thc;
@@ -21,44 +24,65 @@ struct Centaur centaur;
 
 class BoardView : public View {
 private:
-    unique_ptr<Image> pieces;
+    char shown[64];  // Piece drawn on each square, or 0 if not yet drawn
+
+    static constexpr int square_size = 16;
+
+    char piece(int r, int c) const;
+    Rect square_rect(int r, int c) const;
 
 public:
     BoardView();
+    void invalidated(const Context& context, vector<Rect>& rects) override;
     void render(Context& context) override;
 };
 
-BoardView::BoardView()
-    : pieces{Image::readbmp("assets/pieces.bmp")}
-{
+BoardView::BoardView() {
     bounds = {0, 0, 128, 128};
-    if (!pieces) {
-        throw runtime_error("Failed to load pieces.bmp");
+    memset(shown, 0, sizeof shown);
+}
+
+char BoardView::piece(int r, int c) const {
+    Square square = static_cast<Square>(8 * r + c);
+    if (centaur.reversed()) {
+        square = rotate_square(square);
     }
+    return centaur.game->at(square);
 }
 
-void BoardView::render(Context& context) {
-    const auto sprites     = " PRNBQKprnbqk?! ";
-    const auto square_size = 16;
+Rect BoardView::square_rect(int r, int c) const {
+    const auto x = bounds.left + c * square_size;
+    const auto y = bounds.top  + r * square_size;
+    return {x, y, x + square_size, y + square_size};
+}
 
-    const auto left = bounds.left;
-    const auto top  = bounds.top;
+// Squares whose piece has changed
+void BoardView::invalidated(const Context&, vector<Rect>& rects) {
     for (auto r = 0; r != 8; ++r) {
-        const auto y_dst = top + r * square_size;
-
         for (auto c = 0; c != 8; ++c) {
-            const auto x_dst = left + c * square_size;
-            const auto y_src = (r + c) % 2 ? square_size : 0;  // Square color
+            if (piece(r, c) != shown[8 * r + c]) {
+                rects.push_back(square_rect(r, c));
+            }
+        }
+    }
+}
+
+void BoardView::render(Context& context) {
+    const auto sprites = " PRNBQKprnbqk?! ";
 
-            Square square = static_cast<Square>(8 * r + c);
-            if (centaur.reversed()) {
-                square = rotate_square(square);
+    for (auto r = 0; r != 8; ++r) {
+        for (auto c = 0; c != 8; ++c) {
+            const auto rect = square_rect(r, c);
+            if (!rect.intersects(context.clip)) {
+                continue;
             }
 
-            const auto piece  = centaur.game->at(square);
+            const auto y_src  = (r + c) % 2 ? square_size : 0;  // Square color
+            const auto piece  = this->piece(r, c);
             const auto sprite = strchr(sprites, piece);
             const auto x_src  = (sprite - sprites) * square_size;
-            context.drawimage(x_dst, y_dst, *pieces, x_src, y_src, square_size, square_size);
+            context.drawatlas(rect.left, rect.top, PIECES_ATLAS, x_src, y_src, square_size, square_size);
+            shown[8 * r + c] = piece;
         }
     }
 }
@@ -69,8 +93,16 @@ void BoardView::render(Context& context) {
 //
 
 class PgnView : public View {
+private:
+    vector<string> shown;  // Text drawn on each line
+    vector<string> text;   // Text to draw, from last `invalidated`
+
+    vector<string> lines(const Context& context) const;
+    Rect line_rect(const Context& context, int line) const;
+
 public:
     PgnView();
+    void invalidated(const Context& context, vector<Rect>& rects) override;
     void render(Context& context) override;
 };
 
@@ -78,10 +110,9 @@ PgnView::PgnView() {
     bounds = {0, 128, 128, 296};
 }
 
-void PgnView::render(Context& context) {
-    const auto char_width  = context.font->Width;
-    const auto line_height = context.font->Height;
-    const auto num_lines   = (bounds.bottom - bounds.top) / line_height;
+// Text of each line, one move per line, showing the last moves that fit
+vector<string> PgnView::lines(const Context& context) const {
+    const auto num_lines = (bounds.bottom - bounds.top) / context.font->Height;
 
     // Find the last N moves
     auto num_moves  = 0;
@@ -103,28 +134,59 @@ void PgnView::render(Context& context) {
         }
     }
 
-    auto left = bounds.left;
-    auto top  = bounds.top;
+    vector<string> result(num_lines);
+    auto line = result.begin();
     before = begin;      // Rewind to first displayed move
     after  = begin + 1;
 
     char buf[16];
-    for (; after != end; ++before, ++after) {
+    for (; after != end && line != result.end(); ++before, ++after) {
         auto move = (*before)->find_move_played(*after);
         auto san  = (*before)->move_san(*move);
         if ((*before)->WhiteToPlay()) {
-            auto len = sprintf(buf, "%d. %s", first_move, san.c_str());
-            context.drawstring(left, top, buf);
-            left += len * char_width;
+            sprintf(buf, "%d. %s", first_move, san.c_str());
+            *line += buf;
         }
         else {
-            auto len = sprintf(buf, " %s", san.c_str());
-            context.drawstring(left, top, buf);
-            left = bounds.left;  // Go to next line
-            top += line_height;
+            sprintf(buf, " %s", san.c_str());
+            *line += buf;
+            ++line;  // Go to next line
             ++first_move;
         }
     }
+    return result;
+}
+
+Rect PgnView::line_rect(const Context& context, int line) const {
+    const auto top = bounds.top + line * context.font->Height;
+    return {bounds.left, top, bounds.right, top + context.font->Height};
+}
+
+// Lines whose text has changed
+void PgnView::invalidated(const Context& context, vector<Rect>& rects) {
+    text = lines(context);
+    shown.resize(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != shown[i]) {
+            rects.push_back(line_rect(context, i));
+        }
+    }
+}
+
+// Render is called once per invalid rect, so draws the text computed by
+// `invalidated` rather than rebuilding it each time.
+void PgnView::render(Context& context) {
+    if (!bounds.intersects(context.clip)) {
+        return;
+    }
+    for (size_t i = 0; i < text.size(); ++i) {
+        const auto rect = line_rect(context, i);
+        if (!rect.intersects(context.clip)) {
+            continue;
+        }
+        context.drawstring(rect.left, rect.top, text[i].c_str());
+        shown[i] = text[i];
+    }
 }
 
 
@@ -138,6 +200,7 @@ class CentaurView : public View {
 
 public:
     CentaurView();
+    void invalidated(const Context& context, vector<Rect>& rects) override;
     void render(Context& context) override;
 };
 
@@ -145,6 +208,11 @@ CentaurView::CentaurView() {
     bounds = {0, 0, 128, 296};
 }
 
+void CentaurView::invalidated(const Context& context, vector<Rect>& rects) {
+    board_view.invalidated(context, rects);
+    pgn_view.invalidated(context, rects);
+}
+
 void CentaurView::render(Context& context) {
     board_view.render(context);
     pgn_view.render(context);
@@ -168,9 +236,32 @@ void Centaur::on_changed(Game&) {
 void Centaur::set_game(unique_ptr<Game> game) {
     if (centaur.game) {
         centaur.game->unobserve(this);
+        for (auto observer : game_observers) {
+            centaur.game->unobserve(observer);
+        }
     }
     centaur.game = std::move(game);
     centaur.game->observe(this);
+    for (auto observer : game_observers) {
+        centaur.game->observe(observer);
+        observer->on_changed(*centaur.game);
+    }
+}
+
+void Centaur::observe_game(Observer<Game>* observer) {
+    game_observers.push_back(observer);
+    if (game) {
+        game->observe(observer);
+    }
+}
+
+void Centaur::unobserve_game(Observer<Game>* observer) {
+    game_observers.erase(
+        std::remove(game_observers.begin(), game_observers.end(), observer),
+        game_observers.end());
+    if (game) {
+        game->unobserve(observer);
+    }
 }
 
 Centaur::Centaur() {
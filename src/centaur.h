@@ -38,9 +38,14 @@ public:
     // Update display
     void render();
 
-    // Replace current game
+    // Replace current game.  Observers added by `observe_game` move to the new
+    // game, and are notified of it.
     void set_game(std::unique_ptr<Game>);
 
+    // Observe whichever game is current
+    void observe_game(Observer<Game>*);
+    void unobserve_game(Observer<Game>*);
+
     int batterylevel();
     int charging();
 
@@ -65,6 +70,8 @@ public:
     void show_feedback(Bitmap);
 
 private:
+    std::vector<Observer<Game>*> game_observers;
+
     bool reconstruct_move(
         Game&                     game,
         Bitmap                    boardstate,
@@ -156,6 +156,12 @@ void Epd2in9d::read_busy() {
 }
 
 void Epd2in9d::sleep() {
+    // Display doesn't answer when asleep
+    if (asleep) {
+        return;
+    }
+    asleep = true;
+
     spi.send_command(COMMAND_CDI);
     spi.send_data(0xf7);
     spi.send_command(COMMAND_POF);
@@ -172,6 +178,7 @@ void Epd2in9d::sleep() {
 
 void Epd2in9d::wake() {
     gpio_reset();
+    asleep = false;
 
 	spi.send_command(COMMAND_PON);
 	read_busy();
@@ -332,6 +339,12 @@ static const uint8_t black_buffer[SCREEN_BYTES] = {PIXEL_BLACK};
 
 // Fully refresh display
 void Epd2in9d::display(const uint8_t* data) {
+    // Partial updates leave the fast LUT loaded in registers, which wouldn't
+    // clear ghosting.  Reinitializing restores the full LUT from OTP.
+    if (lut_ready) {
+        wake();
+    }
+
     spi.send_command(COMMAND_DTM1);
     spi.send_array(black_buffer, SCREEN_BYTES);
 
@@ -341,21 +354,33 @@ void Epd2in9d::display(const uint8_t* data) {
     refresh_screen();
 }
 
-// Partially update display
-void Epd2in9d::update(const uint8_t* data) {
+// Partially update display, within a window spanning the full width of the
+// display, between rows top and bottom
+void Epd2in9d::update(const uint8_t* data, int top, int bottom) {
+    if (top < 0) {
+        top = 0;
+    }
+    if (bottom > SCREEN_HEIGHT) {
+        bottom = SCREEN_HEIGHT;
+    }
+    if (bottom <= top) {
+        return;
+    }
+    const int last = bottom - 1;
+
     init_lut();
     spi.send_command(COMMAND_PTIN);
     spi.send_command(COMMAND_PTL);
     spi.send_data(0);                        // HRST: Horizontal Start
     spi.send_data(SCREEN_WIDTH - 1);         // HRED: Horizontal End
 
-    spi.send_data(0);                        // VRST: Vertical Start
-    spi.send_data(0);
-    spi.send_data(SCREEN_HEIGHT / 256);      // VRED: Vertical End
-    spi.send_data(SCREEN_HEIGHT % 256 - 1);
+    spi.send_data(top / 256);                // VRST: Vertical Start
+    spi.send_data(top % 256);
+    spi.send_data(last / 256);               // VRED: Vertical End
+    spi.send_data(last % 256);
 
     spi.send_command(COMMAND_DTM2);
-    spi.send_array(data, SCREEN_BYTES);
+    spi.send_array(data + top * WIDTH_BYTES, (bottom - top) * WIDTH_BYTES);
     refresh_screen();
 }
 
@@ -50,12 +50,13 @@ private:
 class Epd2in9d {
     Spi  spi;
     bool lut_ready{false};
+    bool asleep{false};
 
 public:
     ~Epd2in9d();
     Epd2in9d();
 
-    // Put display to sleep
+    // Put display to sleep, unless already asleep
     void sleep();
 
     // Initialize display
@@ -63,11 +64,13 @@ public:
 
     // Fully refresh display.  This is slower and draws more power than partial
     // updates, but should be done occassionally to cleanup e-Paper artifacts.
+    // Reinitializes display if partial updates have changed its LUT.
     void display(const std::uint8_t* data);
 
     // Partially update display.  That is, instruct the e-Paper to make the
-    // minimal changes necessary to display the new image.
-    void update(const std::uint8_t* data);
+    // minimal changes necessary to display the new image.  Only rows from top
+    // up to bottom are sent to the display and refreshed.
+    void update(const std::uint8_t* data, int top = 0, int bottom = SCREEN_HEIGHT);
 
 private:
     void read_busy();
@@ -69,6 +69,37 @@ int cfg_port(void) {
     return s_port ? atoi(s_port) : 80;
 }
 
+// Depth of opening explorer.  Changing it rebuilds statistics on next start.
+int cfg_explorer_plies(void) {
+    const char *s_plies = getenv("EXPLORER_PLIES");
+    const int plies = s_plies ? atoi(s_plies) : 0;
+    return plies > 0 ? plies : 30;
+}
+
+// Threads serving HTTP, each running an event loop.  Zero instead starts a
+// thread for each connection.
+int cfg_httpd_threads(void) {
+    const char *s_threads = getenv("HTTPD_THREADS");
+    const int threads = s_threads ? atoi(s_threads) : 2;
+    return threads > 0 ? threads : 0;
+}
+
+// Built web app, served for any URL not under /api
+const char *cfg_www_dir(void) {
+    const char *www_dir = getenv("WWW_DIR");
+    return www_dir ? www_dir : "app/dist";
+}
+
+int cfg_screen_sleep(void) {
+    const char *s_sleep = getenv("SCREEN_SLEEP");
+    const int seconds = s_sleep ? atoi(s_sleep) : 120;
+    return seconds > 0 ? seconds : 0;
+}
+
+const char *cfg_screen_record(void) {
+    return getenv("SCREEN_RECORD");
+}
+
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
 //
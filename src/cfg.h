@@ -7,6 +7,11 @@
 
 const char *cfg_data_dir(void);
 int cfg_port(void);
+int cfg_explorer_plies(void);
+int cfg_httpd_threads(void);
+const char *cfg_www_dir(void);
+int cfg_screen_sleep(void);
+const char *cfg_screen_record(void);
 
 #endif
 
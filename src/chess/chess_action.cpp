@@ -383,6 +383,12 @@ void ActionHistory::pop_front() {
 }
 
 bool ActionHistory::match_move(const thc::Move& move) const {
+    // Every move ends by placing a piece on its destination.  Checking that
+    // first avoids building a pattern on every poll while a piece is in hand.
+    if (find(this->begin(), end(), place(move.dst)) == end()) {
+        return false;
+    }
+
     const auto pattern = ActionPattern::move(move);
     auto begin = this->begin();
     return pattern.match_actions(begin, end());
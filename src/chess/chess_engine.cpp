@@ -12,7 +12,7 @@ using namespace std;
 using namespace thc;
 
 Engine::Engine(string_view name) {
-    vector<string> argv = { "stockfish", nullptr };
+    vector<string> argv = { "stockfish" };
     uci_ = UCIEngine::execvp("/usr/games/stockfish", argv);
 }
 
@@ -3,12 +3,12 @@
 
 #include "chess_game.h"
 #include "chess_pgn.h"
-#include "../thc/gen.h"
+#include "../thc/movegen.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
-#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -48,6 +48,7 @@ void Game::on_changed(Game&) {
 // Reset game to initial state
 void Game::clear() {
     history.clear();
+    edits.clear();
     started  = 0;
     rowid    = 0;
     settings = "";
@@ -66,22 +67,18 @@ void Game::clear() {
 // Set start position from FEN string
 void Game::fen(string_view fen) {
     clear();
-    history.push_back(make_shared<Position>(fen));
+    history.push_back(PositionTree::root(Position{fen}));
 }
 
 
 void Game::pgn(string_view pgn) {
     clear();
-    history.push_back(make_shared<Position>());
-
-    auto copy = strdup(pgn.data());
-    auto working = copy;
-    pgn::read_tags(working, *this);
-    auto ok = pgn::read_movetext(working, *this);
-    free(copy);
-    if (!ok) {
+    if (!pgn::read_pgn(pgn, *this)) {
         throw domain_error("Invalid PGN");
     }
+    if (history.size() > 1) {
+        changed();
+    }
 }
 
 
@@ -129,6 +126,7 @@ Move Game::uci_move(string_view uci_move) const {
 
 void Game::play_move(Move move) {
     history.push_back(current()->play_move(move));
+    edits.push_back({GameEdit::PLAY, move});
     changed();
 }
 
@@ -149,6 +147,7 @@ void Game::play_uci_move(string_view uci_move) {
 void Game::play_takeback() {
     if (history.size() > 1) {
         history.pop_back();
+        edits.push_back({GameEdit::TAKEBACK, Move{SQUARE_INVALID, SQUARE_INVALID}});
         changed();
     }
 }
@@ -169,10 +168,27 @@ void Game::play_takeback(Move takeback) {
 void Game::revise_move(Move takeback, Move move) {
     play_takeback(takeback);
     current()->remove_move_played(takeback);
+    edits.push_back({GameEdit::REMOVE, takeback});
     play_move(move);
 }
 
 
+void Game::apply_edit(const GameEdit& edit) {
+    switch (edit.kind) {
+    case GameEdit::PLAY:
+        play_move(edit.move);
+        break;
+    case GameEdit::TAKEBACK:
+        play_takeback();
+        break;
+    case GameEdit::REMOVE:
+        current()->remove_move_played(edit.move);
+        edits.push_back(edit);
+        break;
+    }
+}
+
+
 MoveList Game::legal_moves() const {
     return current()->legal_moves();
 }
@@ -239,7 +255,7 @@ bool Game::recover_history(PositionPtr target) {
         return true;
     }
 
-    for (auto movepair : current()->moves_played) {
+    for (auto movepair : current()->moves_played()) {
         history.push_back(movepair.second);
         if (recover_history(target)) {
             return true;
@@ -270,10 +286,10 @@ bool Game::read_revised_move(
 
     if (auto before = previous()) {
         for (auto castle : before->castle_moves()) {
-            const auto after = before->apply_move(castle);
-            if (after->bitmap() != boardstate) {
+            const auto after = before->ChessPosition::play_move(castle);
+            if (after.occupied() != boardstate) {
                 // Castling may still be in-progress
-                maybe_valid = maybe_valid || before->incomplete(boardstate, *after);
+                maybe_valid = maybe_valid || before->incomplete(boardstate, after);
                 continue;
             }
 
@@ -397,110 +413,19 @@ bool Game::IsInsufficientDraw(bool white_asks, DRAWTYPE& result) const {
 int Game::GetRepetitionCount() const {
     auto matches = 0;
 
-    // Search backwards ....
-    auto begin = history.rbegin();
-    auto current = *begin;
-    for (; begin != history.rend(); ++begin) {
-        auto previous = *begin;
-        // ... looking for matching positions
-        if (previous->white          == current->white          &&  // quick ones first!
-            previous->d.wking_square == current->d.wking_square &&
-            previous->d.bking_square == current->d.bking_square &&
-            memcmp(previous->squares, current->squares, sizeof current->squares) == 0)
-        {
+    // Positions hash equal exactly when castling and en passant possibilities
+    // match as well as pieces, so comparing hashes is sufficient.  Only
+    // positions with the same side to move can match, and none from before the
+    // last pawn move or capture.
+    const auto key   = current()->key;
+    const auto reach = min<size_t>(current()->half_move_clock, history.size() - 1);
+    for (size_t back = 0; back <= reach; back += 2) {
+        if (history[history.size() - 1 - back]->key == key) {
             matches++;
-            if (previous->d == current->d) {  // Castling flags and/or enpassant target different?
-                continue;
-            }
-
-            // It might not be a match (but it could be - we have to unpack what
-            // the differences really mean)
-            auto revoke_match = false;
-
-            // Revoke match if different value of en-passant target square means
-            // different en passant possibilities
-            if (previous->d.enpassant_target != current->d.enpassant_target) {
-                int ep_saved = current->d.enpassant_target;
-                int ep_now   = previous->d.enpassant_target;
-
-                // Work out whether each en_passant is a real one, i.e. is there
-                // an opposition pawn in place to capture (if not it's just a
-                // double pawn advance with no actual enpassant consequences)
-                auto real=false;
-                auto ep = ep_saved;
-                char const *squ = current->squares;
-                for (auto j = 0; j < 2; j++) {
-                    if (ep == a6) {
-                        real = (squ[SE(ep)] == 'P');
-                    }
-                    else if (b6 <= ep && ep <= g6) {
-                        real = (squ[SW(ep)] == 'P' || squ[SE(ep)] == 'P');
-                    }
-                    else if (ep == h6) {
-                        real = (squ[SW(ep)] == 'P');
-                    }
-                    else if (ep == a3) {
-                        real = (squ[NE(ep)] == 'p');
-                    }
-                    else if (b3 <= ep && ep <= g3) {
-                        real = (squ[NE(ep)] == 'p' || squ[NW(ep)] == 'p');
-                    }
-                    else if (ep == h3) {
-                        real = (squ[NW(ep)] == 'p' );
-                    }
-                    if (j > 0) {
-                        ep_now = real ? ep : SQUARE_INVALID;    // evaluate second time through
-                    }
-                    else {
-                        ep_saved = real ? ep : SQUARE_INVALID;  // evaluate first time through
-                        ep = ep_now;                            // setup second time through
-                        squ = previous->squares;
-                        real = false;
-                    }
-                }
-
-                // If for example one en_passant is real and the other not, it's
-                // not a real match
-                if (ep_saved != ep_now) {
-                    revoke_match = true;
-                }
-            }
-
-            // Revoke match if different value of castling flags means different
-            //  castling possibilities
-            if (!revoke_match && !eq_castling(previous->d, current->d)) {
-                bool wking_saved  = current->squares[e1]=='K' && current->squares[h1]=='R' && current->d.wking();
-                bool wking_now    = previous->squares[e1]=='K' && previous->squares[h1]=='R' && previous->d.wking();
-                bool bking_saved  = current->squares[e8]=='k' && current->squares[h8]=='r' && current->d.bking();
-                bool bking_now    = previous->squares[e8]=='k' && previous->squares[h8]=='r' && previous->d.bking();
-                bool wqueen_saved = current->squares[e1]=='K' && current->squares[a1]=='R' && current->d.wqueen();
-                bool wqueen_now   = previous->squares[e1]=='K' && previous->squares[a1]=='R' && previous->d.wqueen();
-                bool bqueen_saved = current->squares[e8]=='k' && current->squares[a8]=='r' && current->d.bqueen();
-                bool bqueen_now   = previous->squares[e8]=='k' && previous->squares[a8]=='r' && previous->d.bqueen();
-                revoke_match = (
-                    wking_saved  != wking_now  ||
-                    bking_saved  != bking_now  ||
-                    wqueen_saved != wqueen_now ||
-                    bqueen_saved != bqueen_now
-                );
-            }
-
-            // If the real castling or enpassant possibilities differ, it's not
-            // a match.  At one stage we just did a naive binary match of the
-            // details - not good enough. For example a rook moving away from h1
-            // doesn't affect the WKING flag, but does disallow white king side
-            // castling
-            if (revoke_match) {
-                matches--;
-            }
         }
-
-        // For performance reasons, abandon search early if pawn move or capture
-        // if( squares[m.src]=='P' || squares[m.src]=='p' || !IsEmptySquare(m.capture) )
-        //     break;
     }
 
-    return matches+1;  // +1 counts original position
+    return matches;
 }
 
 
@@ -576,7 +501,7 @@ bool Game::IsLegal(ILLEGAL_REASON& reason) const {
         legal = false;
         ireason |= IR_NOT_ONE_KING_EACH;
     }
-    if (opposition_king_location != SQUARE_INVALID && gen::AttackedPiece(*curr, opposition_king_location)) {
+    if (opposition_king_location != SQUARE_INVALID && movegen::AttackedPiece(*curr, opposition_king_location)) {
         legal = false;
         ireason |= IR_CAN_TAKE_KING;
     }
@@ -8,6 +8,7 @@
 #include "chess_position.h"
 #include "../utility/model.h"
 
+#include <cstdint>
 #include <ctime>
 #include <map>
 #include <optional>
@@ -17,11 +18,25 @@
 
 #include <sqlite3.h>
 
+// Change to a game's moves.  Games record their edits so that they may be
+// saved incrementally, by replaying edits rather than rewriting the PGN.
+struct GameEdit {
+    enum Kind : std::uint8_t {
+        PLAY,      // Play move in current position
+        TAKEBACK,  // Return to previous position
+        REMOVE,    // Unlink move played from current position
+    };
+
+    Kind      kind;
+    thc::Move move;  // Unused for TAKEBACK
+};
+
 class Game : public Model<Game>, public Observer<Game> {
 public:
     std::vector<PositionPtr> history;
+    std::vector<GameEdit>    edits;  // Since last saved or loaded
     std::time_t   started{0};
-    sqlite3_int64 rowid{0};  // SQLite ROWID
+    sqlite3_int64 rowid{0};  // SQLite ROWID, or negative until inserted
     std::string   settings;  // Opaque
     std::map<std::string, std::string> tags;
 
@@ -83,6 +98,9 @@ public:
 
     void revise_move(thc::Move takeback, thc::Move move);
 
+    // Repeat edit, as recorded by this or another copy of the game
+    void apply_edit(const GameEdit&);
+
     // Legal moves in current position
     MoveList legal_moves() const;
 
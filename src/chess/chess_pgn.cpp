@@ -4,8 +4,12 @@
 #include "chess_pgn.h"
 #include "chess_game.h"
 
+#include <algorithm>
+#include <cctype>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace thc;
@@ -47,8 +51,9 @@ static void write_move(
 static void write_moves(ostream& out, PositionPtr before, bool is_first_move) {
     auto show_move_number = is_first_move;
     while (before) {
-        auto begin = before->moves_played.cbegin();
-        if (begin == before->moves_played.cend()) {
+        const auto moves_played = before->moves_played();
+        auto begin = moves_played.cbegin();
+        if (begin == moves_played.cend()) {
             break;
         }
 
@@ -57,7 +62,7 @@ static void write_moves(ostream& out, PositionPtr before, bool is_first_move) {
         show_move_number = false;
 
         ++begin;
-        for (; begin != before->moves_played.cend(); ++begin) {
+        for (; begin != moves_played.cend(); ++begin) {
             out << " (";
             auto variation = *begin;
             write_move(out, before, variation.first, true);
@@ -86,149 +91,256 @@ void pgn::write_pgn(ostream& out, const Game& game) {
 // Read PGN
 //
 
-static void skip_whitespace(char*& pgn) {
-    while (isspace(*pgn)) {
-        ++pgn;
-    }
+static bool is_symbol(char c) {
+    return isalnum((unsigned char)c) || (c && strchr("_+#=:-", c));
 }
 
 
-static char* read_string(char*& pgn) {
-    skip_whitespace(pgn);
-    if (*pgn != '"') {
-        return nullptr;
-    }
-    ++pgn;
+static bool is_result(string_view text) {
+    return text == "1-0" || text == "0-1" || text == "1/2-1/2" || text == "*";
+}
+
 
-    auto begin = pgn;
-    auto end   = begin;
-    while (*pgn && *pgn != '"') {
-        if (*pgn == '\\') {
-            ++pgn;
+pgn::Token pgn::Tokenizer::next() {
+    text  = {};
+    value = {};
+
+    // Skip whitespace and escaped lines
+    for (;;) {
+        while (!rest.empty() && isspace((unsigned char)rest.front())) {
+            at_line_start = rest.front() == '\n';
+            rest.remove_prefix(1);
+        }
+        if (rest.empty() || !(at_line_start && rest.front() == '%')) {
+            break;
         }
-        *end++ = *pgn++;
+        const auto eol = rest.find('\n');
+        rest.remove_prefix(eol == string_view::npos ? rest.size() : eol);
     }
+    at_line_start = false;
 
-    if (*pgn != '"') {
-        return nullptr;
+    if (rest.empty()) {
+        return Token::END;
     }
 
-    *end = '\0';
-    ++pgn;
-    return begin;
-}
-
-
-static char* read_symbol(char*& pgn) {
-    skip_whitespace(pgn);
-    if (!isalpha(*pgn)) {
-        return nullptr;
+    // Consume n characters, returning them
+    auto take = [this](size_t n) {
+        n = min(n, rest.size());
+        const auto result = rest.substr(0, n);
+        rest.remove_prefix(n);
+        return result;
+    };
+
+    // Length of prefix of `rest` (from `start`) satisfying predicate
+    auto span = [this](size_t start, auto predicate) {
+        auto n = start;
+        while (n < rest.size() && predicate(rest[n])) {
+            ++n;
+        }
+        return n;
+    };
+
+    const auto c = rest.front();
+    switch (c) {
+    case '(':
+        take(1);
+        return Token::BEGIN_VARIATION;
+
+    case ')':
+        take(1);
+        return Token::END_VARIATION;
+
+    case '*':
+        text = take(1);
+        return Token::RESULT;
+
+    case '{': {
+        const auto end = rest.find('}');
+        if (end == string_view::npos) {
+            return Token::ERROR;
+        }
+        text = take(end + 1).substr(1, end - 1);
+        return Token::COMMENT;
     }
 
-    auto begin = pgn;
-    while (*pgn && (isalnum(*pgn) || strchr("_+#=:-", *pgn))) {
-        ++pgn;
+    case ';': {
+        const auto end = rest.find('\n');
+        text = take(end).substr(1);
+        return Token::COMMENT;
     }
 
-    return begin;
-}
-
-
-static char* read_tag(char** value, char*& pgn) {
-    skip_whitespace(pgn);
-    if (*pgn != '[') {
-        return nullptr;
+    case '$':
+        text = take(span(1, [](char c) { return isdigit((unsigned char)c); })).substr(1);
+        return text.empty() ? Token::ERROR : Token::NAG;
+
+    case '[': {
+        // [Name "Value"], value is left escaped
+        auto n = span(1, [](char c) { return isspace((unsigned char)c); });
+        const auto name_begin = n;
+        n = span(n, is_symbol);
+        const auto name_end = n;
+        n = span(n, [](char c) { return isspace((unsigned char)c); });
+        if (name_begin == name_end || n >= rest.size() || rest[n] != '"') {
+            return Token::ERROR;
+        }
+        const auto value_begin = ++n;
+        while (n < rest.size() && rest[n] != '"') {
+            n += rest[n] == '\\' ? 2 : 1;
+        }
+        if (n >= rest.size()) {
+            return Token::ERROR;
+        }
+        const auto value_end = n++;
+        n = span(n, [](char c) { return isspace((unsigned char)c); });
+        if (n >= rest.size() || rest[n] != ']') {
+            return Token::ERROR;
+        }
+        text  = rest.substr(name_begin, name_end - name_begin);
+        value = rest.substr(value_begin, value_end - value_begin);
+        take(n + 1);
+        return Token::TAG;
     }
-    ++pgn;
-
-    auto name = read_symbol(pgn);
-    if (!name) {
-        return nullptr;
     }
 
-    *value = read_string(pgn);
-    if (!*value) {
-        return nullptr;
+    if (isdigit((unsigned char)c)) {
+        // Result, or move number followed by any number of periods
+        const auto n = span(0, [](char c) { return isdigit((unsigned char)c) || c == '-' || c == '/'; });
+        if (is_result(rest.substr(0, n))) {
+            text = take(n);
+            return Token::RESULT;
+        }
+        const auto digits = span(0, [](char c) { return isdigit((unsigned char)c); });
+        text = take(digits);
+        take(span(0, [](char c) { return c == '.'; }));
+        return Token::MOVE_NUMBER;
     }
 
-    skip_whitespace(pgn);
-    if (*pgn != ']') {
-        return nullptr;
+    if (isalpha((unsigned char)c)) {
+        // Move, ignoring any trailing annotation, e.g., "!?"
+        text = take(span(0, is_symbol));
+        take(span(0, [](char c) { return c == '!' || c == '?'; }));
+        return Token::SAN;
     }
-    ++pgn;
 
-    return name;
+    return Token::ERROR;
 }
 
 
-void pgn::read_tags(char*& pgn, Game& game) {
-    game.tags.clear();
-
-    char* value = nullptr;
-    char* name  = read_tag(&value, pgn);
-    while (name) {
-        game.tags[name] = value;
-        value = nullptr;
-        name  = read_tag(&value, pgn);
+static string unescape(string_view value) {
+    string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            ++i;
+        }
+        result += value[i];
     }
+    return result;
 }
 
 
-static int read_move_number(char*& pgn) {
-    skip_whitespace(pgn);
+// Variations are read without copying the game history: we need only the
+// position before the most recent move (where a variation branches off) and
+// the current position, saving both when entering a variation.
+bool pgn::read_pgn(string_view& pgn, Game& game) {
+    Tokenizer tokenizer{pgn};
 
-    auto n = 0;
-    while (isdigit(*pgn)) {
-        n = n * 10 + (*pgn++ - '0');
+    // Tags
+    game.tags.clear();
+    auto token = tokenizer.next();
+    for (; token == Token::TAG; token = tokenizer.next()) {
+        game.tags[string{tokenizer.text}] = unescape(tokenizer.value);
     }
 
-    skip_whitespace(pgn);
-    while (*pgn == '.') {
-        ++pgn;
+    // Game may start from position other than the standard starting position
+    Position start;
+    if (auto fen = game.tags.find("FEN"); fen != game.tags.end()) {
+        if (!start.Forsyth(fen->second.data())) {
+            return false;
+        }
     }
+    game.history.clear();
+    game.history.push_back(PositionTree::root(start));
+
+    struct Frame {
+        PositionPtr before;
+        PositionPtr current;
+    };
+    vector<Frame> variations;
+
+    PositionPtr before  = nullptr;
+    PositionPtr current = game.current();
+
+    // Movetext
+    auto mark = tokenizer.rest;  // Before most recent token
+    for (;; mark = tokenizer.rest, token = tokenizer.next()) {
+        switch (token) {
+        case Token::MOVE_NUMBER:
+        case Token::NAG:
+        case Token::COMMENT:
+            break;
 
-    return n;
-}
-
+        case Token::SAN:
+            try {
+                const auto move = current->san_move(tokenizer.text);
+                before  = current;
+                current = current->play_move(move);
+            }
+            catch (const logic_error&) {
+                return false;
+            }
+            if (variations.empty()) {
+                game.history.push_back(current);
+            }
+            break;
 
-bool pgn::read_movetext(char*& pgn, Game& game) {
-    while (*pgn) {
-        skip_whitespace(pgn);
-        if (*pgn == ')') {
-            return true;
-        }
+        case Token::BEGIN_VARIATION:
+            // Variation replaces most recent move
+            if (!before) {
+                return false;
+            }
+            variations.push_back({before, current});
+            current = before;
+            before  = nullptr;
+            break;
 
-        if (*pgn == '(') {
-            auto save_history = game.history;
-            game.play_takeback();
-            ++pgn;
-            if (!read_movetext(pgn, game)) {
+        case Token::END_VARIATION:
+            if (variations.empty()) {
                 return false;
             }
-            if (*pgn != ')') {
+            before  = variations.back().before;
+            current = variations.back().current;
+            variations.pop_back();
+            break;
+
+        case Token::RESULT:
+            if (!variations.empty()) {
                 return false;
             }
-            ++pgn;
-            game.history = save_history;
-            continue;
-        }
+            if (auto result = game.tags.find("Result");
+                result == game.tags.end() || result->second == "*")
+            {
+                game.tags["Result"] = string{tokenizer.text};
+            }
+            pgn = tokenizer.rest;
+            return true;
 
-        (void)read_move_number(pgn);
-        auto san = read_symbol(pgn);
-        if (!san) {
-            return false;
-        }
+        case Token::TAG:
+        case Token::END:
+            // Next game, or end of input, without result
+            if (!variations.empty()) {
+                return false;
+            }
+            pgn = token == Token::TAG ? mark : tokenizer.rest;
+            return true;
 
-        try {
-            game.play_san_move(san);
-        }
-        catch (const logic_error&) {
+        case Token::ERROR:
             return false;
         }
     }
-    return true;
 }
 
+
 // This file is part of the Raccoon's Centaur Mods (RCM).
 //
 // RCM is free software: you can redistribute it and/or modify
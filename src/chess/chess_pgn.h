@@ -6,14 +6,46 @@
 #define CHESS_PGN_H
 
 #include <ostream>
+#include <string_view>
 
 class Game;
 
 namespace pgn {
     void write_pgn(std::ostream&, const Game&);
 
-    void read_tags(char*& pgn, Game& game);
-    bool read_movetext(char*& pgn, Game& game);
+    // Read next game from `pgn` into `game`, replacing its tags and history
+    // and advancing `pgn` past it.  Input may hold many games and is not
+    // copied.  Comments, NAGs and annotations are skipped.  Returns false if
+    // game is malformed.
+    bool read_pgn(std::string_view& pgn, Game& game);
+
+    enum class Token {
+        END,
+        ERROR,
+        TAG,              // text is name, value is (escaped) value
+        MOVE_NUMBER,      // text is number
+        SAN,              // text is move, less annotations
+        NAG,              // text is number
+        COMMENT,          // text is comment
+        BEGIN_VARIATION,
+        END_VARIATION,
+        RESULT,           // text is "1-0", "0-1", "1/2-1/2" or "*"
+    };
+
+    // Splits PGN into tokens.  Token text refers into input.
+    class Tokenizer {
+    public:
+        std::string_view rest;   // Remaining input
+        std::string_view text;   // Current token
+        std::string_view value;  // Tag value
+
+        explicit Tokenizer(std::string_view input) : rest{input} {}
+
+        Token next();
+
+    private:
+        bool at_line_start{true};  // Lines starting with '%' are ignored
+    };
 }
 
 #endif
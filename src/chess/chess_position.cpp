@@ -2,7 +2,6 @@
 // See license at end of file
 
 #include "chess_position.h"
-#include "../thc/gen.h"
 
 #include <algorithm>
 #include <cassert>
@@ -19,61 +18,91 @@ Position::Position(string_view fen) {
 }
 
 
+vector<MovePair> Position::moves_played() const {
+    vector<MovePair> result;
+    if (tree_) {
+        for (auto e = first_edge_; e != PositionTree::NONE; e = tree_->edges[e].next) {
+            const auto& edge = tree_->edges[e];
+            result.push_back({edge.move, tree_->node(edge.child)});
+        }
+    }
+    return result;
+}
+
+
 // Move -> Position
 PositionPtr Position::move_played(const Move& move) const {
-    // Find in `moves_played`
-    auto existing = find_if(
-        moves_played.begin(),
-        moves_played.end(),
-        [move](const MovePair& pair) {
-            return pair.first == move;
+    if (tree_) {
+        for (auto e = first_edge_; e != PositionTree::NONE; e = tree_->edges[e].next) {
+            const auto& edge = tree_->edges[e];
+            if (edge.move == move) {
+                return tree_->node(edge.child);
+            }
         }
-    );
-    return existing != moves_played.end() ? existing->second : nullptr;
+    }
+    return nullptr;
 }
 
 
 // Position -> Move
 optional<Move> Position::find_move_played(PositionPtr after) const {
-    // Find in `moves_played`
-    auto existing = find_if(
-        moves_played.begin(),
-        moves_played.end(),
-        [after](const MovePair& pair) {
-            return pair.second == after;
+    if (tree_) {
+        for (auto e = first_edge_; e != PositionTree::NONE; e = tree_->edges[e].next) {
+            const auto& edge = tree_->edges[e];
+            if (&tree_->nodes[edge.child] == after.get()) {
+                return edge.move;
+            }
         }
-    );
-    if (existing != moves_played.end()) {
-        return existing->first;
-    }
-    else {
-        return nullopt;
     }
+    return nullopt;
 }
 
 
+// Unlinks move, the resulting position remains in the tree until the whole
+// tree is released.
 void Position::remove_move_played(const Move& move) const {
-    moves_played.erase(
-        remove_if(
-            moves_played.begin(),
-            moves_played.end(),
-            [move](const MovePair& pair) {
-                return pair.first == move;
-            }
-        ),
-        moves_played.end()
-    );
+    if (!tree_) {
+        return;
+    }
+
+    auto* link = &first_edge_;
+    while (*link != PositionTree::NONE) {
+        auto& edge = tree_->edges[*link];
+        if (edge.move == move) {
+            *link = edge.next;
+        }
+        else {
+            link = &edge.next;
+        }
+    }
 }
 
 
 PositionPtr Position::play_move(const Move& move) const {
+    // Only needed to read a move from this position, see `move_index`
+    index_.reset();
+
     if (auto existing = move_played(move)) {
         return existing;
     }
 
-    auto after = make_shared<Position>(ChessPosition::play_move(move));
-    moves_played.push_back({move, after});
-    return after;
+    if (!tree_) {
+        // Nowhere to record move
+        return apply_move(move);
+    }
+
+    // Append to end of list, so main line remains first
+    auto* link = &first_edge_;
+    while (*link != PositionTree::NONE) {
+        link = &tree_->edges[*link].next;
+    }
+
+    // Note `link` may refer into `edges`, so fill it in before growing
+    const auto child = tree_->add(ChessPosition::play_move(move));
+    const auto edge  = static_cast<uint32_t>(tree_->edges.size());
+    *link = edge;
+    tree_->edges.push_back({move, child, PositionTree::NONE});
+    return tree_->node(child);
 }
 
 
@@ -82,29 +111,41 @@ PositionPtr Position::apply_move(const Move& move) const {
 }
 
 
-Bitmap Position::bitmap() const {
-    Bitmap bitmap{0};
-    Bitmap mask{1};
-    for (auto sq = a8; sq <= h1; ++sq) {
-        if (!IsEmptySquare(at(sq))) {
-            bitmap |= mask;
-        }
-        mask <<= 1;
-    }
-    return bitmap;
+PositionPtr PositionTree::root(const ChessPosition& position) {
+    auto tree = make_shared<PositionTree>();
+    return tree->node(tree->add(position));
+}
+
+
+uint32_t PositionTree::add(const ChessPosition& position) {
+    nodes.emplace_back(position);
+    nodes.back().tree_ = this;
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+
+PositionPtr PositionTree::node(uint32_t index) {
+    // Shares ownership of the whole tree
+    return PositionPtr{shared_from_this(), &nodes[index]};
 }
 
 
 // Bitmap of differences between two positions (*not* difference of their
 // bitmaps).  Accounts for when a square is occupied by a different piece.
-Bitmap Position::difference_bitmap(const Position& other) const {
-    Bitmap bitmap{0};
-    Bitmap mask{1};
-    for (auto sq = a8; sq <= h1; ++sq) {
+Bitmap Position::difference_bitmap(const ChessPosition& other) const {
+    // Squares that changed colour, including to or from empty ...
+    Bitmap bitmap =
+        (white_pieces ^ other.white_pieces) |
+        (black_pieces ^ other.black_pieces);
+
+    // ... plus squares occupied by same colour but a different piece.
+    auto same = (white_pieces & other.white_pieces) | (black_pieces & other.black_pieces);
+    while (same) {
+        const auto sq = static_cast<Square>(__builtin_ctzll(same));
         if (at(sq) != other.at(sq)) {
-            bitmap |= mask;
+            bitmap |= Bitmap{1} << sq;
         }
-        mask <<= 1;
+        same &= same - 1;
     }
     return bitmap;
 }
@@ -116,7 +157,7 @@ Bitmap Position::difference_bitmap(const Position& other) const {
 //
 // Or, in other words, if the user has lifted or placed some completely
 // unrelated piece, it's not a transition.
-bool Position::incomplete(Bitmap boardstate, const Position& after) const {
+bool Position::incomplete(Bitmap boardstate, const ChessPosition& after) const {
     // What squares differ between this position and the next?
     const auto position_diff = difference_bitmap(after);
 
@@ -129,6 +170,35 @@ bool Position::incomplete(Bitmap boardstate, const Position& after) const {
 }
 
 
+// Board is polled continuously while a piece is moving, so rather than trying
+// every legal move on every poll, index the boardstates each move can produce
+// once, the first time they're needed.  Released by `play_move`, and rebuilt
+// if this position is read again, e.g., after a takeback.
+const MoveIndex& Position::move_index() const {
+    if (index_) {
+        return *index_;
+    }
+
+    auto result = make_shared<MoveIndex>();
+    for (auto move : legal_moves()) {
+        const auto after = ChessPosition::play_move(move);
+        result->moves[after.occupied()].push_back(move);
+
+        // Every boardstate differing from this position only on squares
+        // affected by the move is a possible transition, see `incomplete`.
+        const auto diff = difference_bitmap(after);
+        auto subset = diff;
+        do {
+            result->in_progress.insert(bitmap() ^ subset);
+            subset = (subset - 1) & diff;
+        } while (subset != diff);
+    }
+
+    index_ = result;
+    return *index_;
+}
+
+
 // Construct list of candidate moves in this position that match the given
 // boardstate.  The return indicates if there are any viable candidates:
 // - true if any candidates are found OR if the boardstate could be in
@@ -144,19 +214,17 @@ bool Position::read_move(
 {
     candidates.clear();
 
-    // True if boardstate is compatible with some legal move in this position.
-    auto maybe_valid = false;
+    const auto& index = move_index();
 
-    for (auto move : legal_moves()) {
-        const auto after = apply_move(move);
-        if (after->bitmap() != boardstate) {
-            maybe_valid = maybe_valid || incomplete(boardstate, *after);
-            continue;
-        }
+    // True if boardstate is compatible with some legal move in this position.
+    const auto maybe_valid = index.in_progress.count(boardstate) > 0;
 
-        // Legal move, so valid.
-        maybe_valid = true;
+    const auto found = index.moves.find(boardstate);
+    if (found == index.moves.end()) {
+        return maybe_valid;
+    }
 
+    for (auto move : found->second) {
         // Should only generate multiple candidates for promotions.
         assert(move.is_promotion() || candidates.empty());
 
@@ -192,20 +260,16 @@ bool Position::read_move(
 
 vector<Move> Position::castle_moves() const {
     // Only generate candidate moves if castling is a possibility.
-    vector<Move> king_moves;
-    if (WhiteToPlay() && (wking_allowed() || wqueen_allowed())) {
-        gen::KingMoves(*this, king_square(), king_moves);
+    vector<Move> result;
+    if (WhiteToPlay() && !(wking_allowed() || wqueen_allowed())) {
+        return result;
     }
-    if (BlackToPlay() && (bking_allowed() || bqueen_allowed())) {
-        gen::KingMoves(*this, king_square(), king_moves);
+    if (BlackToPlay() && !(bking_allowed() || bqueen_allowed())) {
+        return result;
     }
 
-    // Filter candidates to legal castling moves.
-    vector<Move> result;
-    for (auto move : king_moves) {
-        if (!Evaluate(move)) {
-            continue;
-        }
+    // Filter legal moves to castling moves.
+    for (auto move : legal_moves()) {
         if (SPECIAL_WK_CASTLING <= move.special && move.special <= SPECIAL_BQ_CASTLING) {
             result.push_back(move);
         }
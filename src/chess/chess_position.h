@@ -9,9 +9,12 @@
 #include "../thc/thc.h"
 
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -20,6 +23,7 @@
 using Bitmap = std::uint64_t;
 
 class Position;
+class PositionTree;
 using PositionPtr = std::shared_ptr<const Position>;
 
 using MoveList = std::vector<thc::Move>;
@@ -27,13 +31,38 @@ using MoveList = std::vector<thc::Move>;
 // Represents both a move and the resulting position.
 using MovePair = std::pair<thc::Move, PositionPtr>;
 
+// Boardstates reachable from a position, built lazily by `Position::read_move`
+// and released once a move is played from it
+struct MoveIndex {
+    std::unordered_map<Bitmap, MoveList> moves;  // Resulting bitmap -> moves
+    std::unordered_set<Bitmap> in_progress;      // Accepted by `incomplete`
+};
+
 class Position : public thc::ChessPosition {
-public:
-    mutable std::vector<MovePair> moves_played;
+private:
+    mutable std::shared_ptr<const MoveIndex> index_;
+
+    // Tree this position belongs to, if any, and head of its list of moves
+    // played (index into tree's edges).
+    PositionTree* tree_{nullptr};
+    mutable std::uint32_t first_edge_{UINT32_MAX};
+
+    const MoveIndex& move_index() const;
 
+    friend class PositionTree;
+
+public:
     Position(const thc::ChessPosition& position) : thc::ChessPosition(position) {}
     explicit Position(std::string_view fen = {});
 
+    // Copies are detached from any tree
+    Position(const Position& other) : Position{static_cast<const thc::ChessPosition&>(other)} {}
+    Position& operator=(const Position&) = delete;
+
+    // Moves previously played in this position, with resulting positions, in
+    // the order they were first played (i.e., main line first).
+    std::vector<MovePair> moves_played() const;
+
     // If move has previously been played in this position, return the shared
     // resulting position.
     PositionPtr move_played(const thc::Move&) const;
@@ -44,18 +73,22 @@ public:
     // Play move and return resulting position.  Result may be new or shared.
     //
     // `play_move` updates `moves_played` with the move and resulting position.
-    // `apply_move` does not.
+    // `apply_move` does not.  Positions outside of a tree, such as those
+    // returned by `apply_move`, have nowhere to record moves played, so for
+    // them `play_move` behaves like `apply_move`.
     PositionPtr play_move(const thc::Move&) const;
     PositionPtr apply_move(const thc::Move&) const;
 
     // Bitmap of pieces on board.
-    Bitmap bitmap() const;
+    Bitmap bitmap() const { return occupied(); }
+    Bitmap white_bitmap() const { return white_pieces; }
+    Bitmap black_bitmap() const { return black_pieces; }
 
     // Bitmap of differences between two positions.
-    Bitmap difference_bitmap(const Position&) const;
+    Bitmap difference_bitmap(const thc::ChessPosition&) const;
 
     // True if boardstate might represent a transition into position `after`
-    bool incomplete(Bitmap boardstate, const Position& after) const;
+    bool incomplete(Bitmap boardstate, const thc::ChessPosition& after) const;
 
     // Yield list of legal moves matching both boardstate and action history.
     bool read_move(
@@ -66,6 +99,36 @@ public:
     MoveList castle_moves() const;
 };
 
+
+// Arena holding a starting position and every position played from it, i.e., a
+// game with all its variations.  Positions are not freed individually, but all
+// together when the last `PositionPtr` into the tree is dropped, and positions
+// and moves are linked by 32-bit index rather than by pointer.  This keeps
+// large analysed games compact and avoids fragmenting the heap.
+class PositionTree : public std::enable_shared_from_this<PositionTree> {
+private:
+    static constexpr std::uint32_t NONE = UINT32_MAX;
+
+    // A move played, linking position to resulting position
+    struct Edge {
+        thc::Move     move;
+        std::uint32_t child;  // Index into `nodes`
+        std::uint32_t next;   // Next move played from the same position
+    };
+
+    std::deque<Position> nodes;  // Does not move elements on growth
+    std::vector<Edge>    edges;
+
+    std::uint32_t add(const thc::ChessPosition&);
+    PositionPtr node(std::uint32_t);
+
+    friend class Position;
+
+public:
+    // Start new tree, returning its root
+    static PositionPtr root(const thc::ChessPosition&);
+};
+
 #endif
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
@@ -53,6 +53,9 @@ UCIEngine::~UCIEngine() {
     if (write_fd >= 0) {
         quit();
     }
+    else if (thread.joinable()) {
+        thread.join();
+    }
 }
 
 void UCIEngine::send_response(unique_ptr<UCIMessage> response) {
@@ -148,6 +151,7 @@ shared_ptr<UCIEngine> UCIEngine::execvp(string file, vector<string> argv) {
         for (auto i = 0; i != argv.size(); ++i) {
             args.push_back(argv[i].data());
         }
+        args.push_back(nullptr);
         ::execvp(file.data(), args.data());
         _exit(EXIT_FAILURE);
     }
@@ -185,6 +189,10 @@ char* UCIEngine::getline() {
     return buffer.getline(1000 /* milliseconds */);
 }
 
+bool UCIEngine::exited() const {
+    return buffer.closed();
+}
+
 // Getline, but only if it matches prefix
 char* UCIEngine::expect(const char* startswith) {
     auto line = getline();
@@ -290,6 +298,40 @@ bool UCIHintMessage::handle_exchange(UCIEngine& engine) {
 }
 
 
+//
+//
+
+bool UCIPerftMessage::handle_exchange(UCIEngine& engine) {
+    engine.printf("position fen %s\n", fen.data());
+    engine.printf("go perft %d\n", depth);
+
+    for (;;) {
+        if (engine.peek_request()) {
+            return true;
+        }
+
+        auto line = engine.getline();
+        if (!line) {
+            if (engine.exited()) {
+                // Respond, with `nodes` still -1, rather than wait forever
+                return true;
+            }
+            continue;
+        }
+
+        char uci[8];
+        long count;
+        if (sscanf(line, "Nodes searched: %ld", &count) == 1) {
+            nodes = count;
+            return true;
+        }
+        if (sscanf(line, "%7[a-h1-8nbrq]: %ld", uci, &count) == 2) {
+            divide[uci] = count;
+        }
+    }
+}
+
+
 // This file is part of the Raccoon's Centaur Mods (RCM).
 //
 // RCM is free software: you can redistribute it and/or modify
@@ -14,6 +14,7 @@
 #include <mutex>
 #include <optional>
 #include <queue>
+#include <string>
 #include <thread>
 
 
@@ -25,11 +26,11 @@ class UCIEngine {
 private:
     std::mutex              mutex;  // Lock request and response queues
     std::condition_variable cond;   // Signal new request (poll for responses)
-    std::thread             thread;
     std::queue<std::unique_ptr<UCIMessage>> request_queue;
     std::queue<std::unique_ptr<UCIMessage>> response_queue;
     Buffer buffer;    // Receive from UCI engine
     int    write_fd;  // Send to UCI engine
+    std::thread thread;  // Last, so it starts after everything it uses
 
     // Only spawn one instance of any given UCI engine
     static std::map<std::pair<std::string, std::vector<std::string>>,  // (file, argv)
@@ -52,6 +53,7 @@ public:
     // For use by UCIMessage implementations
     char* expect(const char* startswith);
     char* getline();
+    bool  exited() const;  // No more output, e.g., engine died
     void  printf(const char* format, ...);
 
     // Look to see if there's a new request in the queue
@@ -113,6 +115,20 @@ public:
     bool handle_exchange(UCIEngine& engine) override;
 };
 
+
+// Ask engine to count leaf nodes ("go perft"), e.g., to cross-check our own
+// move generator.
+class UCIPerftMessage : public UCIMessage {
+public:
+    std::string fen;
+    int         depth;
+    std::map<std::string, long> divide;  // UCI move -> nodes
+    long        nodes{-1};               // Total, or -1 on failure
+
+    UCIPerftMessage(std::string fen, int depth) : fen{std::move(fen)}, depth{depth} {}
+    bool handle_exchange(UCIEngine& engine) override;
+};
+
 #endif
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
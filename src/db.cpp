@@ -4,18 +4,22 @@
 #include "db.h"
 #include "cfg.h"
 #include "chess/chess.h"
+#include "chess/chess_pgn.h"
+#include "thc/zobrist.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 using namespace std;
 
-Database db;
-
 static auto SCHEMA =
     "CREATE TABLE IF NOT EXISTS games ("
     "  event    TEXT,"  // Seven Tag Roster (STR)
@@ -25,102 +29,927 @@ static auto SCHEMA =
     "  white    TEXT,"
     "  black    TEXT,"
     "  result   TEXT,"
-    "  pgn      TEXT,"  // Full game, including variations
-    "  fen      TEXT,"  // Identifies current position
+    "  pgn      TEXT,"  // Full game, including variations, and position
+    "  fen      TEXT,"  // reached (as FEN), except for edits since
     "  settings TEXT"   // JSON string describing game settings
-    ");";
+    ");"
+    // Catalogue
+    "CREATE INDEX IF NOT EXISTS games_date   ON games (date);"
+    "CREATE INDEX IF NOT EXISTS games_white  ON games (white);"
+    "CREATE INDEX IF NOT EXISTS games_black  ON games (black);"
+    "CREATE INDEX IF NOT EXISTS games_result ON games (result);"
+    // Positions reached in each game, by Zobrist hash
+    "CREATE TABLE IF NOT EXISTS positions ("
+    "  key      INTEGER NOT NULL,"
+    "  game     INTEGER NOT NULL,"  // Games ROWID
+    "  ply      INTEGER NOT NULL,"  // Zero is starting position
+    "  PRIMARY KEY (key, game, ply)"
+    ") WITHOUT ROWID;"
+    "CREATE INDEX IF NOT EXISTS positions_game ON positions (game, ply);"
+    // Opening explorer: how often each continuation was played from each
+    // position (by hash), and with what results.  Counts games to a limited
+    // number of plies, recorded in `explorer`.
+    "CREATE TABLE IF NOT EXISTS openings ("
+    "  key      INTEGER NOT NULL,"
+    "  next     INTEGER NOT NULL,"  // Hash of resulting position
+    "  games    INTEGER NOT NULL,"
+    "  white    INTEGER NOT NULL,"  // Wins
+    "  draws    INTEGER NOT NULL,"
+    "  black    INTEGER NOT NULL,"
+    "  PRIMARY KEY (key, next)"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS explorer ("
+    "  plies    INTEGER NOT NULL"
+    ");"
+    // Log of edits to each game since its PGN was last written, so that saving
+    // a move costs the same however long the game.  See `update_game`.
+    "CREATE TABLE IF NOT EXISTS edits ("
+    "  game     INTEGER NOT NULL,"  // Games ROWID
+    "  seq      INTEGER NOT NULL,"  // Order applied
+    "  edit     INTEGER NOT NULL,"  // See `encode`
+    "  PRIMARY KEY (game, seq)"
+    ") WITHOUT ROWID;";
+
+// Schema version, stored as user_version.  Version 1 indexes positions, and
+// version 2 adds opening statistics.
+static const int VERSION = 2;
+
+// Statements are prepared once, on first use
+static const char INSERT_GAME[] =
+    "INSERT INTO games"
+    "  (event, site, date, round, white, black, result, pgn, fen, settings)"
+    " VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+// Parameters numbered as for INSERT_GAME.  Rows are written only if changed,
+// which after the first few moves is rarely.
+static const char UPDATE_TAGS[] =
+    "UPDATE games SET"
+    "  event = ?1, site  = ?2, date   = ?3, round    = ?4,"
+    "  white = ?5, black = ?6, result = ?7, settings = ?10"
+    " WHERE rowid = ?11"
+    " AND (event, site, date, round, white, black, result, settings)"
+    "  IS NOT (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?10)";
+
+static const char UPDATE_PGN[] =
+    "UPDATE games SET pgn = ?, fen = ? WHERE rowid = ?";
+
+static const char LAST_EDIT[] =
+    "SELECT MAX(seq) FROM edits WHERE game = ?";
+
+static const char INSERT_EDIT[] =
+    "INSERT INTO edits (game, seq, edit) VALUES(?, ?, ?)";
+
+static const char SELECT_EDITS[] =
+    "SELECT edit FROM edits WHERE game = ? ORDER BY seq";
+
+static const char DELETE_EDITS[] =
+    "DELETE FROM edits WHERE game = ?";
+
+// Tags in the PGN are as first saved, and columns as last saved
+static const char SELECT_GAME[] =
+    "SELECT pgn, fen, settings, event, site, date, round, white, black, result"
+    " FROM games WHERE rowid = ?";
+
+static const char SELECT_LATEST[] =
+    "SELECT MAX(rowid) FROM games";
+
+static const char SELECT_LINE[] =
+    "SELECT key FROM positions WHERE game = ? ORDER BY ply";
+
+static const char SELECT_RESULT[] =
+    "SELECT result FROM games WHERE rowid = ?";
+
+static const char DELETE_POSITIONS[] =
+    "DELETE FROM positions WHERE game = ? AND ply >= ?";
+
+static const char INSERT_POSITION[] =
+    "INSERT OR IGNORE INTO positions (key, game, ply) VALUES(?, ?, ?)";
+
+static const char COUNT_OPENING[] =
+    "INSERT INTO openings (key, next, games, white, draws, black)"
+    " VALUES(?1, ?2, ?3, ?4, ?5, ?6)"
+    " ON CONFLICT (key, next) DO UPDATE SET"
+    "  games = games + ?3, white = white + ?4, draws = draws + ?5, black = black + ?6";
+
+static const char DELETE_UNPLAYED[] =
+    "DELETE FROM openings WHERE key = ? AND next = ? AND games <= 0";
+
+static const char SELECT_OPENINGS[] =
+    "SELECT next, games, white, draws, black FROM openings"
+    " WHERE key = ? AND games > 0 ORDER BY games DESC";
+
+// Rebuild opening statistics from positions, e.g., when `plies` changes
+static const char REBUILD_OPENINGS[] =
+    "DELETE FROM openings;"
+    "INSERT INTO openings (key, next, games, white, draws, black)"
+    " SELECT a.key, b.key, COUNT(*),"
+    "  SUM(g.result = '1-0'), SUM(g.result = '1/2-1/2'), SUM(g.result = '0-1')"
+    " FROM positions a"
+    " JOIN positions b ON b.game = a.game AND b.ply = a.ply + 1"
+    " JOIN games g ON g.rowid = a.game"
+    " WHERE a.ply < (SELECT plies FROM explorer)"
+    " GROUP BY a.key, b.key;";
+
+static const char FIND_POSITION[] =
+    "SELECT g.rowid, g.event, g.site, g.date, g.round, g.white, g.black, g.result,"
+    "  MIN(p.ply)"
+    " FROM positions p JOIN games g ON g.rowid = p.game"
+    " WHERE p.key = ?1 AND p.game < ?2"
+    " GROUP BY p.game ORDER BY p.game DESC LIMIT ?3";
+
+// Edits logged before game's PGN is rewritten to include them
+static const sqlite3_int64 COMPACT_EDITS = 64;
+
+// Write-ahead log avoids most fsyncs on the SD card.  With synchronous=NORMAL,
+// a power cut may lose the last few moves, but never corrupts the database.
+// Other processes, e.g., pgn_import, may hold the write lock for a batch, so
+// wait for them rather than failing.
+static auto PRAGMAS =
+    "PRAGMA busy_timeout = 5000;"
+    "PRAGMA journal_mode = WAL;"
+    "PRAGMA synchronous  = NORMAL;"
+    "PRAGMA temp_store   = MEMORY;"
+    "PRAGMA mmap_size    = 16777216;";
 
 Database::~Database() {
+    {
+        lock_guard<std::mutex> lock(queue_mutex);
+        shutdown = true;
+    }
+    cond.notify_all();
+    writer.join();
+
+    for (auto& statement : statements) {
+        sqlite3_finalize(statement.second);
+    }
     sqlite3_close(db);
 }
 
-Database::Database() {
+static string default_path() {
     char* path = nullptr;
     asprintf(&path, "%s/rcm.db", cfg_data_dir());
+    string result = path;
+    free(path);
+    return result;
+}
+
+Database::Database() : Database{default_path().c_str()} {}
+
+Database::Database(const char* path) : plies{cfg_explorer_plies()} {
     if (sqlite3_open(path, &db) != SQLITE_OK) {
+        sqlite3_close(db);
         throw runtime_error("Failed to open database");
     }
+    sqlite3_exec(db, PRAGMAS, nullptr, nullptr, nullptr);
     sqlite3_exec(db, SCHEMA, nullptr, nullptr, nullptr);
+    migrate();
+    writer = std::thread(&Database::write_updates, this);
 }
 
-int Database::insert_game(Game& game) {
-    auto sql =
-        "INSERT INTO games"
-        "  (event, site, date, round, white, black, result, pgn, fen, settings)"
-        " VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+static int select_int(sqlite3* db, const char* sql) {
     sqlite3_stmt* stmt = nullptr;
-    auto rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+    const auto result = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Bring games saved by earlier versions, or with other settings, up to date
+void Database::migrate() {
+    const auto version = select_int(db, "PRAGMA user_version");
+    const auto counted = select_int(db, "SELECT plies FROM explorer");
+    if (version >= VERSION && counted == plies) {
+        return;
+    }
+
+    lock_guard<std::mutex> lock(mutex);
+    sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr);
+
+    auto sql = "DELETE FROM explorer; INSERT INTO explorer VALUES(" + to_string(plies) + ")";
+    sqlite3_exec(db, sql.data(), nullptr, nullptr, nullptr);
+
+    if (version < 1) {
+        // Replay every game to index its positions, which also counts openings
+        vector<sqlite3_int64> rowids;
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(db, "SELECT rowid FROM games", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            rowids.push_back(sqlite3_column_int64(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+
+        sqlite3_exec(db, "DELETE FROM openings", nullptr, nullptr, nullptr);
+        for (auto rowid : rowids) {
+            if (auto game = select_game(rowid)) {
+                index_positions(rowid, keys(*game), game->tag("Result"));
+            }
+        }
+    } else {
+        sqlite3_exec(db, REBUILD_OPENINGS, nullptr, nullptr, nullptr);
+    }
+
+    sql = "PRAGMA user_version = " + to_string(VERSION);
+    sqlite3_exec(db, sql.data(), nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+}
+
+// Return cached statement, reset and ready to bind.  Caller holds lock.
+sqlite3_stmt* Database::statement(const string& sql) {
+    auto& stmt = statements[sql];
+    if (stmt) {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    } else if (sqlite3_prepare_v3(db, sql.data(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+    }
+    return stmt;
+}
+
+// New games are saved whole, saved games need only their edits since
+Database::Row Database::row(Game& game) {
+    Row r{
+        game.rowid,
+        game.tag("Event"),
+        game.tag("Site"),
+        game.tag("Date"),
+        game.tag("Round"),
+        game.tag("White"),
+        game.tag("Black"),
+        game.tag("Result"),
+        game.rowid > 0 ? "" : game.pgn(),
+        game.rowid > 0 ? "" : game.fen(),
+        game.settings,
+        keys(game),
+        move(game.edits),
+    };
+    game.edits.clear();
+    return r;
+}
+
+// Edits are stored as 16-bit integers: source and destination squares in bits
+// 0-11, promotion in bits 12-14, and bit 15 set to remove rather than play.
+// Takeback is zero, which is no move.
+static int encode(const GameEdit& edit) {
+    if (edit.kind == GameEdit::TAKEBACK) {
+        return 0;
+    }
+    const int promotion = edit.move.is_promotion()
+        ? edit.move.special - thc::SPECIAL_PROMOTION_QUEEN + 1
+        : 0;
+    return edit.move.src
+        | edit.move.dst << 6
+        | promotion     << 12
+        | (edit.kind == GameEdit::REMOVE) << 15;
+}
+
+// Moves are completed (castling, captures, etc.) from position they are made
+// in.  Throws if move is not legal there.
+static GameEdit decode(int code, const Game& game) {
+    if (code == 0) {
+        return {GameEdit::TAKEBACK, thc::Move{thc::SQUARE_INVALID, thc::SQUARE_INVALID}};
+    }
+    const auto promotion = (code >> 12) & 7;
+    const thc::Move partial{
+        static_cast<thc::Square>(code & 63),
+        static_cast<thc::Square>((code >> 6) & 63),
+        promotion ? thc::SPECIAL(thc::SPECIAL_PROMOTION_QUEEN + promotion - 1) : thc::NOT_SPECIAL,
+    };
+    return {
+        code & (1 << 15) ? GameEdit::REMOVE : GameEdit::PLAY,
+        game.uci_move(partial.uci()),
+    };
+}
+
+// Hash of each position in game's current line.  Hashes are stored as signed,
+// since SQLite integers are.
+vector<sqlite3_int64> Database::keys(const Game& game) {
+    vector<sqlite3_int64> result;
+    result.reserve(game.history.size());
+    for (const auto& position : game.history) {
+        result.push_back(static_cast<sqlite3_int64>(position->key));
+    }
+    return result;
+}
+
+// Replace game's positions, and its contribution to opening statistics.  Only
+// the part of the line that changed is rewritten, which is usually just the
+// latest move.  Caller holds lock, within transaction, before updating game.
+int Database::index_positions(
+    sqlite3_int64                rowid,
+    const vector<sqlite3_int64>& keys,
+    const string&                result)
+{
+    // Line and result as previously counted
+    vector<sqlite3_int64> previous;
+    auto stmt = statement(SELECT_LINE);
+    if (!stmt) {
         return 1;
     }
+    sqlite3_bind_int64(stmt, 1, rowid);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        previous.push_back(sqlite3_column_int64(stmt, 0));
+    }
+    sqlite3_reset(stmt);
 
-    sqlite3_bind_text(stmt,  1, game.tag("Event").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  2, game.tag("Site").data(),   -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  3, game.tag("Date").data(),   -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  4, game.tag("Round").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  5, game.tag("White").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  6, game.tag("Black").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  7, game.tag("Result").data(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  8, game.pgn().data(),         -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt,  9, game.fen().data(),         -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 10, game.settings.data(),      -1, SQLITE_STATIC);
+    string previous_result;
+    if (!previous.empty()) {
+        stmt = statement(SELECT_RESULT);
+        if (!stmt) {
+            return 1;
+        }
+        sqlite3_bind_int64(stmt, 1, rowid);
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            previous_result = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_reset(stmt);
+    }
 
-    rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    // Positions from first difference
+    size_t same = 0;
+    while (same < previous.size() && same < keys.size() && previous[same] == keys[same]) {
+        ++same;
+    }
 
-    game.rowid = sqlite3_last_insert_rowid(db);
-    return rc != SQLITE_DONE;
+    stmt = statement(DELETE_POSITIONS);
+    if (!stmt) {
+        return 1;
+    }
+    sqlite3_bind_int64(stmt, 1, rowid);
+    sqlite3_bind_int64(stmt, 2, same);
+    auto rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        return 1;
+    }
+
+    stmt = statement(INSERT_POSITION);
+    if (!stmt) {
+        return 1;
+    }
+    for (size_t ply = same; ply < keys.size(); ++ply) {
+        sqlite3_bind_int64(stmt, 1, keys[ply]);
+        sqlite3_bind_int64(stmt, 2, rowid);
+        sqlite3_bind_int64(stmt, 3, ply);
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            return 1;
+        }
+    }
+
+    // Moves are unchanged up to first difference, unless result changed
+    const size_t from = previous_result != result ? 0 : same > 0 ? same - 1 : 0;
+    return count_openings(previous, previous_result, from, -1)
+        || count_openings(keys, result, from, +1);
 }
 
-int Database::update_game(Game& game) {
-    auto sql =
-        "UPDATE games SET"
-        "  event = ?, site  = ?, date     = ?, round = ?,"
-        "  white = ?, black = ?, result   = ?,"
-        "  pgn   = ?, fen   = ?, settings = ?"
-        " WHERE rowid = ?";
-    sqlite3_stmt* stmt = nullptr;
-    auto rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+// Add (or with `sign` negative, remove) moves of line from ply `from`
+int Database::count_openings(
+    const vector<sqlite3_int64>& line,
+    const string&                result,
+    size_t                       from,
+    int                          sign)
+{
+    const int white = result == "1-0"     ? sign : 0;
+    const int draw  = result == "1/2-1/2" ? sign : 0;
+    const int black = result == "0-1"     ? sign : 0;
+
+    for (auto ply = from; ply + 1 < line.size() && ply < size_t(plies); ++ply) {
+        auto stmt = statement(COUNT_OPENING);
+        if (!stmt) {
+            return 1;
+        }
+        sqlite3_bind_int64(stmt, 1, line[ply]);
+        sqlite3_bind_int64(stmt, 2, line[ply + 1]);
+        sqlite3_bind_int(stmt, 3, sign);
+        sqlite3_bind_int(stmt, 4, white);
+        sqlite3_bind_int(stmt, 5, draw);
+        sqlite3_bind_int(stmt, 6, black);
+        auto rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            return 1;
+        }
+
+        if (sign < 0) {
+            stmt = statement(DELETE_UNPLAYED);
+            if (!stmt) {
+                return 1;
+            }
+            sqlite3_bind_int64(stmt, 1, line[ply]);
+            sqlite3_bind_int64(stmt, 2, line[ply + 1]);
+            rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            if (rc != SQLITE_DONE) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+void Database::bind(sqlite3_stmt* stmt, const Row& row) {
+    sqlite3_bind_text(stmt,  1, row.event.data(),    -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  2, row.site.data(),     -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  3, row.date.data(),     -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  4, row.round.data(),    -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  5, row.white.data(),    -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  6, row.black.data(),    -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  7, row.result.data(),   -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  8, row.pgn.data(),      -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt,  9, row.fen.data(),      -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 10, row.settings.data(), -1, SQLITE_STATIC);
+}
+
+// Caller holds lock, within transaction.  The PGN is as of the latest save,
+// so edits since earlier saves are already part of it.
+int Database::insert_game(const Row& r, sqlite3_int64& rowid) {
+    auto stmt = statement(INSERT_GAME);
+    if (!stmt) {
         return 1;
     }
+    bind(stmt, r);
+    const auto rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        return 1;
+    }
+    rowid = sqlite3_last_insert_rowid(db);
+    return index_positions(rowid, r.keys, r.result);
+}
+
+// Caller holds lock.  Rather than rewriting the whole game, appends its edits
+// to the log, which is replayed on load and now and then folded into the PGN.
+int Database::update_game(const Row& r) {
+    // Positions first, as they need the result previously saved
+    if (index_positions(r.rowid, r.keys, r.result)) {
+        return 1;
+    }
+
+    auto stmt = statement(UPDATE_TAGS);
+    if (!stmt) {
+        return 1;
+    }
+    bind(stmt, r);
+    sqlite3_bind_int64(stmt, 11, r.rowid);
+    auto rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        return 1;
+    }
+
+    stmt = statement(LAST_EDIT);
+    if (!stmt) {
+        return 1;
+    }
+    sqlite3_bind_int64(stmt, 1, r.rowid);
+    sqlite3_int64 seq = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_reset(stmt);
 
-    sqlite3_bind_text( stmt,  1, game.tag("Event").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  2, game.tag("Site").data(),   -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  3, game.tag("Date").data(),   -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  4, game.tag("Round").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  5, game.tag("White").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  6, game.tag("Black").data(),  -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  7, game.tag("Result").data(), -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  8, game.pgn().data(),         -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt,  9, game.fen().data(),         -1, SQLITE_STATIC);
-    sqlite3_bind_text( stmt, 10, game.settings.data(),      -1, SQLITE_STATIC);
-    sqlite3_bind_int64(stmt, 11, game.rowid);
+    stmt = statement(INSERT_EDIT);
+    if (!stmt) {
+        return 1;
+    }
+    for (const auto& edit : r.edits) {
+        sqlite3_bind_int64(stmt, 1, r.rowid);
+        sqlite3_bind_int64(stmt, 2, ++seq);
+        sqlite3_bind_int(stmt, 3, encode(edit));
+        rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            return 1;
+        }
+    }
+
+    // Finished games are stored whole.  Should that fail, e.g., as a logged
+    // edit no longer replays, keep the log and save the edits regardless.
+    if (seq >= COMPACT_EDITS || (seq > 0 && r.result != "*")) {
+        sqlite3_exec(db, "SAVEPOINT compact", nullptr, nullptr, nullptr);
+        if (compact_game(r.rowid)) {
+            fprintf(stderr, "Failed to compact game %lld\n", static_cast<long long>(r.rowid));
+            sqlite3_exec(db, "ROLLBACK TO compact", nullptr, nullptr, nullptr);
+        }
+        sqlite3_exec(db, "RELEASE compact", nullptr, nullptr, nullptr);
+    }
+    return 0;
+}
+
+// Rewrite game's PGN to include its logged edits, and tags changed since it
+// was written.  Fails unless every edit replays, as the log is then deleted.
+// Caller holds lock.
+int Database::compact_game(sqlite3_int64 rowid) {
+    const auto game = select_game(rowid, true);
+    if (!game) {
+        return 1;
+    }
+    const auto pgn = game->pgn();
+    const auto fen = game->fen();
+
+    auto stmt = statement(UPDATE_PGN);
+    if (!stmt) {
+        return 1;
+    }
+    sqlite3_bind_text(stmt, 1, pgn.data(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, fen.data(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 3, rowid);
+    auto rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        return 1;
+    }
 
+    stmt = statement(DELETE_EDITS);
+    if (!stmt) {
+        return 1;
+    }
+    sqlite3_bind_int64(stmt, 1, rowid);
     rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return rc != SQLITE_DONE;
 }
 
+// How long to wait before retrying failed writes, e.g., while another process
+// holds the database
+static const auto RETRY_DELAY = chrono::seconds(1);
+
+// Background writer, so saving after every move never waits on the SD card.
+// The queue has its own lock, so the game can queue saves while the writer
+// holds the connection.
+void Database::write_updates() {
+    for (;;) {
+        deque<Row> rows;
+        {
+            unique_lock<std::mutex> lock(queue_mutex);
+            cond.wait(lock, [this]() { return shutdown || !pending.empty(); });
+            if (pending.empty()) {
+                break;  // Shutdown, and nothing left to write
+            }
+            rows.swap(pending);
+            writing = true;
+        }
+
+        // Write everything queued in one transaction, each game within its own
+        // savepoint, so that a game which fails leaves no partial writes
+        vector<bool> saved(rows.size(), false);
+        vector<sqlite3_int64> rowids(rows.size(), 0);  // Of new games
+        {
+            lock_guard<std::mutex> lock(mutex);
+            if (sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr) == SQLITE_OK) {
+                for (size_t i = 0; i < rows.size(); ++i) {
+                    sqlite3_exec(db, "SAVEPOINT game", nullptr, nullptr, nullptr);
+                    saved[i] = rows[i].rowid < 0
+                        ? !insert_game(rows[i], rowids[i])
+                        : !update_game(rows[i]);
+                    if (!saved[i]) {
+                        fprintf(stderr, "Failed to save game %lld: %s\n",
+                            static_cast<long long>(rows[i].rowid), sqlite3_errmsg(db));
+                        sqlite3_exec(db, "ROLLBACK TO game", nullptr, nullptr, nullptr);
+                    }
+                    sqlite3_exec(db, "RELEASE game", nullptr, nullptr, nullptr);
+                }
+                if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                    fprintf(stderr, "Failed to save games: %s\n", sqlite3_errmsg(db));
+                    sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+                    saved.assign(rows.size(), false);
+                }
+            } else {
+                fprintf(stderr, "Failed to save games: %s\n", sqlite3_errmsg(db));
+            }
+        }
+
+        deque<Row> failed;
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (!saved[i]) {
+                failed.push_back(move(rows[i]));
+            }
+        }
+
+        {
+            unique_lock<std::mutex> lock(queue_mutex);
+
+            // New games keep their provisional id until their next save, and
+            // saves queued meanwhile update the game inserted
+            for (size_t i = 0; i < rows.size(); ++i) {
+                if (saved[i] && rowids[i]) {
+                    inserted[rows[i].rowid] = rowids[i];
+                    for (auto& p : pending) {
+                        if (p.rowid == rows[i].rowid) {
+                            p.rowid = rowids[i];
+                        }
+                    }
+                }
+            }
+
+            failing = !failed.empty();
+            if (failing && shutdown) {
+                fprintf(stderr, "Giving up on %zu unsaved games\n", failed.size());
+                failed.clear();
+            }
+
+            // Requeue failed games ahead of any later saves, whose edits follow
+            for (auto r = failed.rbegin(); r != failed.rend(); ++r) {
+                auto later = find_if(pending.begin(), pending.end(),
+                    [&r](const Row& p) { return p.rowid == r->rowid; });
+                if (later != pending.end()) {
+                    later->edits.insert(later->edits.begin(), r->edits.begin(), r->edits.end());
+                } else {
+                    pending.push_front(move(*r));
+                }
+            }
+            writing = false;
+            cond.notify_all();
+
+            if (failing) {
+                cond.wait_for(lock, RETRY_DELAY, [this]() { return shutdown; });
+            }
+        }
+    }
+}
+
 int Database::save_game(Game& game) {
-    return game.rowid ? update_game(game) : insert_game(game);
+    if (!game.rowid) {
+        lock_guard<std::mutex> lock(queue_mutex);
+        game.rowid = --provisional;
+    }
+
+    // Snapshot outside of lock.  Only latest state of each game is written.
+    auto r = row(game);
+    {
+        lock_guard<std::mutex> lock(queue_mutex);
+        if (auto found = inserted.find(r.rowid); found != inserted.end()) {
+            // Inserted since last save, later saves update it
+            game.rowid = r.rowid = found->second;
+            inserted.erase(found);
+        }
+
+        auto same = find_if(pending.begin(), pending.end(),
+            [&r](const Row& p) { return p.rowid == r.rowid; });
+        if (same != pending.end()) {
+            // Earlier edits are not yet written either
+            r.edits.insert(r.edits.begin(), same->edits.begin(), same->edits.end());
+            *same = move(r);
+        } else {
+            pending.push_back(move(r));
+        }
+    }
+    cond.notify_all();
+    return 0;
 }
 
-unique_ptr<Game> Database::load_game(sqlite3_int64 rowid) {
+// Each combination of filters is its own statement, so that each can use the
+// appropriate index.  There are few enough combinations to cache them all.
+int Database::list_games(const GameQuery& query, vector<GameSummary>& games) {
+    games.clear();
+
+    string sql =
+        "SELECT rowid, event, site, date, round, white, black, result"
+        " FROM games WHERE rowid < ?1";
+    if (!query.player.empty()) {
+        sql += " AND (white = ?2 OR black = ?2)";
+    }
+    if (!query.result.empty()) {
+        sql += " AND result = ?3";
+    }
+    if (!query.date_from.empty()) {
+        sql += " AND date >= ?4";
+    }
+    if (!query.date_to.empty()) {
+        sql += " AND date <= ?5";
+    }
+    sql += " ORDER BY rowid DESC LIMIT ?6";
+
+    lock_guard<std::mutex> lock(mutex);
+    auto stmt = statement(sql);
+    if (!stmt) {
+        return 1;
+    }
+
+    auto bind_text = [stmt](int i, const string& value) {
+        if (!value.empty()) {
+            sqlite3_bind_text(stmt, i, value.data(), -1, SQLITE_STATIC);
+        }
+    };
+    sqlite3_bind_int64(stmt, 1, query.before > 0 ? query.before : INT64_MAX);
+    bind_text(2, query.player);
+    bind_text(3, query.result);
+    bind_text(4, query.date_from);
+    bind_text(5, query.date_to);
+    sqlite3_bind_int(stmt, 6, query.limit);
+
+    auto text = [stmt](int i) {
+        auto value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+        return string{value ? value : ""};
+    };
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        games.push_back({
+            sqlite3_column_int64(stmt, 0),
+            text(1), text(2), text(3), text(4), text(5), text(6), text(7),
+        });
+    }
+    sqlite3_reset(stmt);
+    return rc != SQLITE_DONE;
+}
+
+int Database::find_position(
+    const thc::ChessPosition& position,
+    sqlite3_int64             before,
+    int                       limit,
+    vector<PositionMatch>&    matches)
+{
+    matches.clear();
+
+    lock_guard<std::mutex> lock(mutex);
+    auto stmt = statement(FIND_POSITION);
+    if (!stmt) {
+        return 1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(position.key));
+    sqlite3_bind_int64(stmt, 2, before > 0 ? before : INT64_MAX);
+    sqlite3_bind_int(stmt, 3, limit);
+
+    auto text = [stmt](int i) {
+        auto value = reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+        return string{value ? value : ""};
+    };
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        matches.push_back({
+            {
+                sqlite3_column_int64(stmt, 0),
+                text(1), text(2), text(3), text(4), text(5), text(6), text(7),
+            },
+            sqlite3_column_int(stmt, 8),
+        });
+    }
+    sqlite3_reset(stmt);
+    return rc != SQLITE_DONE;
+}
+
+int Database::explore(const thc::ChessPosition& position, vector<OpeningMove>& moves) {
+    moves.clear();
+
+    // Statistics record resulting positions rather than moves
+    struct Continuation {
+        sqlite3_int64 next;
+        long games, white, draws, black;
+    };
+    vector<Continuation> continuations;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        auto stmt = statement(SELECT_OPENINGS);
+        if (!stmt) {
+            return 1;
+        }
+
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(position.key));
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            continuations.push_back({
+                sqlite3_column_int64(stmt, 0),
+                long(sqlite3_column_int64(stmt, 1)),
+                long(sqlite3_column_int64(stmt, 2)),
+                long(sqlite3_column_int64(stmt, 3)),
+                long(sqlite3_column_int64(stmt, 4)),
+            });
+        }
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            return 1;
+        }
+    }
+    if (continuations.empty()) {
+        return 0;
+    }
+
+    // Find moves leading to them, most played first
+    const auto legal = position.legal_moves();
+    for (const auto& each : continuations) {
+        for (const auto& move : legal) {
+            if (static_cast<sqlite3_int64>(position.play_move(move).key) == each.next) {
+                moves.push_back({move, each.games, each.white, each.draws, each.black});
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+void Database::flush() {
+    unique_lock<std::mutex> lock(queue_mutex);
+    cond.wait(lock, [this]() { return (pending.empty() || failing) && !writing; });
+}
+
+// Skip remainder of malformed game: its tags, if any, then everything up to
+// the next game's tags.  Always makes progress on non-empty input.
+static void skip_game(string_view& pgn) {
+    auto at_tag = [&pgn]() {
+        const auto n = pgn.find_first_not_of(" \t\r");
+        return n != string_view::npos && pgn[n] == '[';
+    };
+    auto skip_line = [&pgn]() {
+        const auto eol = pgn.find('\n');
+        pgn.remove_prefix(eol == string_view::npos ? pgn.size() : eol + 1);
+    };
+
+    pgn.remove_prefix(min(pgn.find_first_not_of(" \t\r\n"), pgn.size()));
+    while (!pgn.empty() && at_tag()) {
+        skip_line();
+    }
+    while (!pgn.empty() && !at_tag()) {
+        skip_line();
+    }
+}
+
+int Database::import_pgn(string_view pgn, ImportStats& stats, long batch_size) {
+    const auto started = chrono::steady_clock::now();
+
+    // One statement for all games, one transaction for each batch
+    lock_guard<std::mutex> lock(mutex);
+    auto stmt = statement(INSERT_GAME);
+    if (!stmt) {
+        return 1;
+    }
+
+    auto failed = [&]() {
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        stats.seconds += chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        return 1;
+    };
+
+    if (sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return 1;
+    }
+
+
+    Game game;
+    long batched = 0;
+    while (!pgn.empty()) {
+        // Moves are validated as they are played
+        const auto rest = pgn;
+        if (!pgn::read_pgn(pgn, game)) {
+            pgn = rest;
+            skip_game(pgn);
+            ++stats.skipped;
+            continue;
+        }
+        if (game.tags.empty() && game.history.size() < 2) {
+            // Trailing whitespace or escaped lines
+            continue;
+        }
+
+        auto tag = [&game](const char* name) {
+            const auto tag = game.tags.find(name);
+            return tag != game.tags.end() ? tag->second : "?";
+        };
+        const Row r{
+            0,
+            tag("Event"), tag("Site"), tag("Date"), tag("Round"),
+            tag("White"), tag("Black"), tag("Result"),
+            game.pgn(), game.fen(), "",
+            keys(game),
+            {},
+        };
+        bind(stmt, r);
+
+        const auto rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE || index_positions(sqlite3_last_insert_rowid(db), r.keys, r.result)) {
+            return failed();
+        }
+        ++stats.games;
+
+        if (++batched >= batch_size) {
+            batched = 0;
+            if (sqlite3_exec(db, "COMMIT; BEGIN IMMEDIATE", nullptr, nullptr, nullptr) != SQLITE_OK) {
+                return failed();
+            }
+        }
+    }
+
+    if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        return failed();
+    }
+    stats.seconds += chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    return 0;
+}
+
+// Caller holds lock.  If `strict`, fails unless every logged edit is replayed.
+unique_ptr<Game> Database::select_game(sqlite3_int64 rowid, bool strict) {
     assert(rowid > 0);
 
-    auto sql = "SELECT pgn, fen, settings FROM games WHERE rowid = ?";
-    sqlite3_stmt* stmt = nullptr;
-    auto rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    auto stmt = statement(SELECT_GAME);
+    if (!stmt) {
         return nullptr;
     }
 
     sqlite3_bind_int64(stmt, 1, rowid);
-    rc = sqlite3_step(stmt);
-
-    if (rc != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_reset(stmt);
         return nullptr;
     }
 
@@ -136,7 +965,7 @@ unique_ptr<Game> Database::load_game(sqlite3_int64 rowid) {
     }
 
     if (!game) {
-        sqlite3_finalize(stmt);
+        sqlite3_reset(stmt);
         return nullptr;
     }
 
@@ -146,27 +975,70 @@ unique_ptr<Game> Database::load_game(sqlite3_int64 rowid) {
         game->settings = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
     }
 
-    sqlite3_finalize(stmt);
+    // Later saves update only the columns, so they take precedence
+    static const char* ROSTER[] = {"Event", "Site", "Date", "Round", "White", "Black", "Result"};
+    for (size_t i = 0; i < size(ROSTER); ++i) {
+        if (auto value = sqlite3_column_text(stmt, 3 + i)) {
+            game->tag(ROSTER[i]) = reinterpret_cast<const char*>(value);
+        }
+    }
+    sqlite3_reset(stmt);
+
+    // Replay edits logged since PGN was written.  Should one fail, keep the
+    // game as far as it goes.
+    stmt = statement(SELECT_EDITS);
+    if (!stmt) {
+        return nullptr;
+    }
+    sqlite3_bind_int64(stmt, 1, rowid);
+    auto rc = SQLITE_DONE;
+    try {
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            game->apply_edit(decode(sqlite3_column_int(stmt, 0), *game));
+        }
+    }
+    catch (const logic_error&) {
+        fprintf(stderr, "Invalid edit to game %lld\n", static_cast<long long>(rowid));
+    }
+    sqlite3_reset(stmt);
+    if (strict && rc != SQLITE_DONE) {
+        return nullptr;
+    }
+
+    game->edits.clear();
     return game;
 }
 
+unique_ptr<Game> Database::load_game(sqlite3_int64 rowid) {
+    flush();
+    if (rowid < 0) {
+        lock_guard<std::mutex> lock(queue_mutex);
+        const auto found = inserted.find(rowid);
+        rowid = found != inserted.end() ? found->second : 0;
+    }
+    if (rowid <= 0) {
+        return nullptr;
+    }
+    lock_guard<std::mutex> lock(mutex);
+    return select_game(rowid);
+}
+
 unique_ptr<Game> Database::load_latest(void) {
-    const char* sql = "SELECT MAX(rowid) FROM games";
-    sqlite3_stmt* stmt = nullptr;
-    auto rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
-    if (rc != SQLITE_OK) {
+    flush();
+    lock_guard<std::mutex> lock(mutex);
+    auto stmt = statement(SELECT_LATEST);
+    if (!stmt) {
         return nullptr;
     }
 
-    rc = sqlite3_step(stmt);
-    if (rc != SQLITE_ROW) {
-        sqlite3_finalize(stmt);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_reset(stmt);
         return nullptr;
     }
 
     sqlite3_int64 rowid = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
-    return rowid > 0 ? load_game(rowid) : nullptr;
+    sqlite3_reset(stmt);
+    return rowid > 0 ? select_game(rowid) : nullptr;
 }
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
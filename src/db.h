@@ -5,27 +5,148 @@
 #ifndef DB_H
 #define DB_H
 
+#include "chess/chess_game.h"
+
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <sqlite3.h>
 
-struct Game;
+// Catalogue entry, i.e., Seven Tag Roster without the moves
+struct GameSummary {
+    sqlite3_int64 rowid;
+    std::string   event, site, date, round, white, black, result;
+};
+
+// Catalogue filter and page.  Empty fields match everything.  Pages run from
+// newest to oldest, and `before` is the rowid of last game on previous page.
+struct GameQuery {
+    std::string   player;     // White or black
+    std::string   result;     // E.g., "1-0"
+    std::string   date_from;  // PGN date, "YYYY.MM.DD", inclusive
+    std::string   date_to;
+    sqlite3_int64 before{0};  // Zero for first page
+    int           limit{50};
+};
+
+// Game reaching a position, and the first ply at which it did
+struct PositionMatch {
+    GameSummary game;
+    int         ply;
+};
+
+// Continuation from a position in stored games, for opening explorer
+struct OpeningMove {
+    thc::Move move;
+    long      games;  // Played, including unfinished games
+    long      white;  // Won by white
+    long      draws;
+    long      black;  // Won by black
+};
+
+// Progress of a bulk import
+struct ImportStats {
+    long   games{0};    // Inserted
+    long   skipped{0};  // Malformed or illegal, not inserted
+    double seconds{0};  // Elapsed
+};
 
 class Database {
+    // Snapshot of a game as stored, so it may be written after game changes
+    struct Row {
+        sqlite3_int64 rowid;  // Negative until inserted, see `save_game`
+        std::string   event, site, date, round, white, black, result;
+        std::string   pgn, fen, settings;
+        std::vector<sqlite3_int64> keys;  // Position hashes, by ply
+        std::vector<GameEdit>      edits; // Since previous save
+    };
+
     sqlite3 *db;
 
+    // Opening explorer counts moves up to this ply
+    const int plies;
+
+    // Prepared statements, keyed by SQL
+    std::unordered_map<std::string, sqlite3_stmt*> statements;
+
+    std::mutex              mutex;        // Lock connection
+    std::mutex              queue_mutex;  // Lock pending writes, and flags
+    std::condition_variable cond;         // Signal writes pending or done
+    std::deque<Row>         pending;      // Updates waiting for writer
+    sqlite3_int64           provisional{0};  // Last id given to a new game
+    std::unordered_map<sqlite3_int64, sqlite3_int64> inserted;  // Provisional id -> rowid
+    bool writing{false};
+    bool failing{false};  // Most recent write failed, and will be retried
+    bool shutdown{false};
+    std::thread writer;  // Last, so it starts after everything it uses
+
 public:
     ~Database();
     Database();
+    explicit Database(const char* path);
 
+    // Queue game to be written in the background.  A new game is given a
+    // provisional (negative) id, which `load_game` also accepts, until the
+    // first save after it's inserted assigns its rowid.
     int save_game(Game&);
     std::unique_ptr<Game> load_game(sqlite3_int64 rowid);
     std::unique_ptr<Game> load_latest();
 
+    // List games matching query, without loading their moves.  Returns
+    // non-zero on database error.
+    int list_games(const GameQuery&, std::vector<GameSummary>&);
+
+    // List games reaching position (by hash, so ignoring move counters), newest
+    // first.  `before` is a rowid cursor as for `list_games`.  Returns non-zero
+    // on database error.
+    int find_position(
+        const thc::ChessPosition&   position,
+        sqlite3_int64               before,
+        int                         limit,
+        std::vector<PositionMatch>& matches);
+
+    // Continuations played from position, most played first.  Reads only
+    // precomputed statistics, which are updated as games are saved.  Returns
+    // non-zero on database error.
+    int explore(const thc::ChessPosition& position, std::vector<OpeningMove>& moves);
+
+    // Block until queued saves have been written, or have failed to be
+    void flush();
+
+    // Insert every game in multi-game PGN, validating moves.  Games are
+    // committed in batches of `batch_size`, and malformed games are skipped.
+    // Returns non-zero on database error, after rolling back current batch.
+    int import_pgn(std::string_view pgn, ImportStats&, long batch_size = 1000);
+
 private:
-    int insert_game(Game&);
-    int update_game(Game&);
+    sqlite3_stmt* statement(const std::string& sql);
+    void migrate();
+    static Row row(Game&);
+    static std::vector<sqlite3_int64> keys(const Game&);
+    int index_positions(
+        sqlite3_int64                     rowid,
+        const std::vector<sqlite3_int64>& keys,
+        const std::string&                result);
+    int count_openings(
+        const std::vector<sqlite3_int64>& line,
+        const std::string&                result,
+        std::size_t                       from,
+        int                               sign);
+    static void bind(sqlite3_stmt*, const Row&);
+    int insert_game(const Row&, sqlite3_int64& rowid);
+    int update_game(const Row&);
+    int compact_game(sqlite3_int64 rowid);
+    std::unique_ptr<Game> select_game(sqlite3_int64 rowid, bool strict = false);
+    void write_updates();
 };
 
+// Board's database, defined by rcm
 extern Database db;
 
 #endif
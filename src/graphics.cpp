@@ -3,11 +3,16 @@
 
 #include "graphics.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
+#include <alloca.h>
+
 Context::Context()
     : image{nullptr},
       foreground{PIXEL_BLACK},
@@ -17,7 +22,8 @@ Context::Context()
       line_style{LINE_STYLE_SOLID},
       line_width{1},
       rotate{ROTATE_180},
-      font{&Font16}
+      font{&Font16},
+      clip{0, 0, INT_MAX, INT_MAX}
 {
 }
 
@@ -47,7 +53,21 @@ void Context::transform_point(int& x, int& y) const {
     }
 }
 
+Rect Context::transform_rect(const Rect& rect) const {
+    if (rect.empty()) {
+        return {0, 0, 0, 0};
+    }
+    auto x0 = rect.left,      y0 = rect.top;
+    auto x1 = rect.right - 1, y1 = rect.bottom - 1;
+    transform_point(x0, y0);
+    transform_point(x1, y1);
+    return {std::min(x0, x1), std::min(y0, y1), std::max(x0, x1) + 1, std::max(y0, y1) + 1};
+}
+
 void Context::setpixel(int x, int y, PixelColor color) {
+    if (x < clip.left || clip.right <= x || y < clip.top || clip.bottom <= y) {
+        return;
+    }
     transform_point(x, y);
     if (x < 0 || image->width <= x || y < 0 || image->height <= y) {
         return;
@@ -170,37 +190,21 @@ void Context::fillrect(int x0, int y0, int x1, int y1) {
 }
 
 void Context::eraserect(int x0, int y0, int x1, int y1) {
-    for (auto y = y0; y <= y1; ++y) {
-        for (auto x = x0; x <= x1; ++x) {
-            setpixel(x, y, background);
-        }
-    }
+    blit(x0, y0, nullptr, 0, 0, 0, x1 - x0 + 1, y1 - y0 + 1, background, background);
 }
 
 void Context::drawchar(int x, int y, char c) {
-    auto index = (c - ' ') * font->Height * (font->Width / 8 + (font->Width % 8 ? 1 : 0));
-    auto ptr = &font->table[index];
-
-    for (auto r = 0; r < font->Height; ++r) {
-        for (auto c = 0; c < font->Width; ++c) {
-            if (*ptr & (0x80 >> (c % 8))) {
-                setpixel(x + c, y + r, foreground);
-            }
-            else {
-                setpixel(x + c, y + r, background);
-            }
-
-            // Move to next byte of font data
-            if (c % 8 == 7) {
-                ptr++;
-            }
-        }
-
-        // Move to next row of font data
-        if (font->Width % 8 != 0) {
-            ptr++;
-        }
+    // Atlas only helps when already rotated to match
+    const auto atlas = font_atlas(font);
+    const auto glyph = c - ' ';
+    if (atlas && atlas->rotate == rotate && 0 <= glyph && glyph < atlas->height / atlas->cell_height) {
+        drawatlas(x, y, *atlas, 0, glyph * font->Height, font->Width, font->Height);
+        return;
     }
+
+    const auto stride = font->Width / 8 + (font->Width % 8 ? 1 : 0);
+    const auto table  = &font->table[glyph * font->Height * stride];
+    blit(x, y, table, stride, 0, 0, font->Width, font->Height, foreground, background);
 }
 
 void Context::drawstring(int left, int top, const char* s) {
@@ -232,20 +236,236 @@ void Context::drawimage(
     int w,
     int h)
 {
-    for (auto y = 0; y < h; ++y) {
-        for (auto x = 0; x < w; ++x) {
-            const auto x_src = x_from + x;
-            const auto y_src = y_from + y;
-            const auto x_dst = x_to + x;
-            const auto y_dst = y_to + y;
-            if (x_src < 0 || source.width <= x_src || y_src < 0 || source.height <= y_src) {
-                continue;
+    // Clip to source
+    if (x_from < 0) {
+        x_to -= x_from;
+        w    += x_from;
+        x_from = 0;
+    }
+    if (y_from < 0) {
+        y_to -= y_from;
+        h    += y_from;
+        y_from = 0;
+    }
+    w = std::min(w, source.width  - x_from);
+    h = std::min(h, source.height - y_from);
+
+    blit(x_to, y_to, source.data(), source.width_bytes, x_from, y_from, w, h, background, foreground);
+}
+
+//
+// Blitter
+//
+// Images are stored a row at a time, 8 pixels to the byte, most significant
+// bit first, so unrotated, or rotated 180 degrees, each row of source pixels
+// lands in a single row of the image.  We copy whole rows of bits, shifting
+// them into place when source and destination aren't aligned, and reversing
+// their order when rotated.  Rotations by 90 degrees go pixel by pixel.
+//
+
+namespace {
+
+constexpr std::array<std::uint8_t, 256> make_reversed() {
+    std::array<std::uint8_t, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        int r = 0;
+        for (int b = 0; b < 8; ++b) {
+            r |= (i >> b & 1) << (7 - b);
+        }
+        table[i] = r;
+    }
+    return table;
+}
+
+constexpr auto REVERSED = make_reversed();
+
+// Read n bits, starting at bit offset of row, into out starting at bit 0
+void load_bits(const std::uint8_t* row, int offset, int n, std::uint8_t* out) {
+    row += offset / 8;
+    const int shift  = offset % 8;
+    const int nbytes = (n + 7) / 8;
+    if (shift == 0) {
+        memcpy(out, row, nbytes);
+        return;
+    }
+    const int last = (shift + n - 1) / 8;  // Last byte of row to read
+    for (int i = 0; i < nbytes; ++i) {
+        const std::uint8_t next = i < last ? row[i + 1] : 0;
+        out[i] = row[i] << shift | next >> (8 - shift);
+    }
+}
+
+// Reverse order of first n bits
+void reverse_bits(std::uint8_t* bits, int n) {
+    const int nbytes = (n + 7) / 8;
+    std::reverse(bits, bits + nbytes);
+    for (int i = 0; i < nbytes; ++i) {
+        bits[i] = REVERSED[bits[i]];
+    }
+
+    // Reversed bits end at end of last byte, so shift them up to bit 0
+    const int pad = 8 * nbytes - n;
+    if (pad) {
+        for (int i = 0; i < nbytes - 1; ++i) {
+            bits[i] = bits[i] << pad | bits[i + 1] >> (8 - pad);
+        }
+        bits[nbytes - 1] <<= pad;
+    }
+}
+
+// Write first n bits to row, starting at bit offset, leaving other bits alone
+void store_bits(std::uint8_t* row, int offset, int n, const std::uint8_t* bits) {
+    row += offset / 8;
+    const int shift = offset % 8;
+    if (shift == 0) {
+        memcpy(row, bits, n / 8);
+        if (n % 8) {
+            const std::uint8_t mask = 0xff00 >> (n % 8);
+            row[n / 8] = (row[n / 8] & ~mask) | (bits[n / 8] & mask);
+        }
+        return;
+    }
+    for (int i = 0; n > 0; ++i, n -= 8) {
+        const int k = std::min(n, 8);
+        const std::uint16_t mask  = std::uint16_t(0xffff << (16 - k)) >> shift;
+        const std::uint16_t value = std::uint16_t(bits[i] << 8) >> shift;
+        row[i] = (row[i] & ~(mask >> 8)) | ((value & mask) >> 8);
+        if (mask & 0xff) {
+            row[i + 1] = (row[i + 1] & ~mask) | (value & mask);
+        }
+    }
+}
+
+}
+
+// Copy w x h pixels from source, whose rows are stride bytes, drawing set bits
+// in one color and clear bits in another.  Without source, fill with color.
+void Context::blit(
+    int x_to,
+    int y_to,
+    const std::uint8_t* source,
+    int stride,
+    int x_from,
+    int y_from,
+    int w,
+    int h,
+    PixelColor set,
+    PixelColor clear)
+{
+    if (rotate != ROTATE_0 && rotate != ROTATE_180) {
+        for (auto y = 0; y < h; ++y) {
+            for (auto x = 0; x < w; ++x) {
+                const auto x_src = x_from + x;
+                const auto y_src = y_from + y;
+                const auto bit   = source && source[y_src * stride + x_src / 8] & (0x80 >> (x_src % 8));
+                setpixel(x_to + x, y_to + y, bit ? set : clear);
+            }
+        }
+        return;
+    }
+
+    // Clip destination, adjusting source to match
+    const auto left   = std::max({x_to, clip.left, 0});
+    const auto top    = std::max({y_to, clip.top, 0});
+    const auto right  = std::min({x_to + w, clip.right, image->width});
+    const auto bottom = std::min({y_to + h, clip.bottom, image->height});
+    if (right <= left || bottom <= top) {
+        return;
+    }
+    x_from += left - x_to;
+    y_from += top  - y_to;
+    const auto n = right - left;
+
+    const auto bits = (std::uint8_t*)alloca(n / 8 + 2);
+    if (!source || set == clear) {
+        memset(bits, set, n / 8 + 2);
+    }
+
+    for (auto y = top; y < bottom; ++y) {
+        if (source && set != clear) {
+            load_bits(source + (y_from + y - top) * stride, x_from, n, bits);
+            if (set == PIXEL_BLACK) {
+                for (auto i = 0; i < (n + 7) / 8; ++i) {
+                    bits[i] = ~bits[i];
+                }
+            }
+            if (rotate == ROTATE_180) {
+                reverse_bits(bits, n);
+            }
+        }
+
+        if (rotate == ROTATE_180) {
+            const auto row = image->data() + (image->height - 1 - y) * image->width_bytes;
+            store_bits(row, image->width - right, n, bits);
+        } else {
+            const auto row = image->data() + y * image->width_bytes;
+            store_bits(row, left, n, bits);
+        }
+    }
+}
+
+// Cells of an atlas are already rotated, so when that matches the context,
+// each row of the cell is copied as-is to the image, in order.
+void Context::drawatlas(
+    int x_to,
+    int y_to,
+    const Atlas& atlas,
+    int x_from,
+    int y_from,
+    int w,
+    int h)
+{
+    if (atlas.rotate == ROTATE_0) {
+        blit(x_to, y_to, atlas.data, atlas.width_bytes, x_from, y_from, w, h, background, foreground);
+        return;
+    }
+    assert(atlas.rotate == ROTATE_180);
+
+    const auto cell_x = x_from - x_from % atlas.cell_width;
+    const auto cell_y = y_from - y_from % atlas.cell_height;
+
+    if (rotate != atlas.rotate) {
+        // Undo rotation of atlas pixel by pixel
+        for (auto y = 0; y < h; ++y) {
+            for (auto x = 0; x < w; ++x) {
+                const auto x_src = 2 * cell_x + atlas.cell_width  - 1 - (x_from + x);
+                const auto y_src = 2 * cell_y + atlas.cell_height - 1 - (y_from + y);
+                const auto bit   = atlas.data[y_src * atlas.width_bytes + x_src / 8] & (0x80 >> (x_src % 8));
+                setpixel(x_to + x, y_to + y, bit ? background : foreground);
+            }
+        }
+        return;
+    }
+
+    const auto left   = std::max({x_to, clip.left, 0});
+    const auto top    = std::max({y_to, clip.top, 0});
+    const auto right  = std::min({x_to + w, clip.right, image->width});
+    const auto bottom = std::min({y_to + h, clip.bottom, image->height});
+    if (right <= left || bottom <= top) {
+        return;
+    }
+    const auto n = right - left;
+
+    // Clipped source rectangle, rotated
+    const auto x_src = 2 * cell_x + atlas.cell_width  - (x_from + right  - x_to);
+    const auto y_src = 2 * cell_y + atlas.cell_height - (y_from + bottom - y_to);
+
+    const auto bits = (std::uint8_t*)alloca(n / 8 + 2);
+    if (foreground == background) {
+        memset(bits, background, n / 8 + 2);
+    }
+
+    for (auto y = 0; y < bottom - top; ++y) {
+        if (foreground != background) {
+            load_bits(atlas.data + (y_src + y) * atlas.width_bytes, x_src, n, bits);
+            if (background == PIXEL_BLACK) {
+                for (auto i = 0; i < (n + 7) / 8; ++i) {
+                    bits[i] = ~bits[i];
+                }
             }
-            const auto byte = source.data_[y_src * source.width_bytes + x_src / 8];
-            const auto bit  = 0x80 >> (x_src % 8);
-            const auto color = byte & bit ? background : foreground;
-            setpixel(x_dst, y_dst, color);
         }
+        const auto row = image->data() + (image->height - bottom + y) * image->width_bytes;
+        store_bits(row, image->width - right, n, bits);
     }
 }
 
@@ -4,9 +4,14 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
+#include "atlas.h"
 #include "fonts/fonts.h"
 #include "image.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
 enum DotStyle {
     DOT_FILL_AROUND,
     DOT_FILL_RIGHTUP,
@@ -27,6 +32,40 @@ enum Rotate {
 
 struct sFONT;
 
+// Right and bottom edges are exclusive
+struct Rect {
+    int left;
+    int top;
+    int right;
+    int bottom;
+
+    bool empty() const {
+        return right <= left || bottom <= top;
+    }
+
+    bool intersects(const Rect& other) const {
+        return
+            left < other.right && other.left < right &&
+            top < other.bottom && other.top < bottom;
+    }
+
+    // Smallest rectangle containing both
+    Rect united(const Rect& other) const {
+        if (empty()) {
+            return other;
+        }
+        if (other.empty()) {
+            return *this;
+        }
+        return {
+            std::min(left, other.left),
+            std::min(top, other.top),
+            std::max(right, other.right),
+            std::max(bottom, other.bottom),
+        };
+    }
+};
+
 class Context {
 public:
     Image*       image;
@@ -38,9 +77,13 @@ public:
     int          line_width;
     Rotate       rotate;
     const sFONT* font;
+    Rect         clip;  // Nothing is drawn outside of clip
 
     Context();
 
+    // Rectangle on image covered by rectangle in drawing coordinates
+    Rect transform_rect(const Rect& rect) const;
+
     void clear();
     void drawpoint(int x, int y, PixelColor color);
     void drawline(int x0, int y0, int x1, int y1);
@@ -57,19 +100,34 @@ public:
         int w,
         int h);
 
+    // Draw from atlas, as drawimage, where source rectangle is in coordinates
+    // of atlas before rotation, and lies within a single cell
+    void drawatlas(
+        int x_to,
+        int y_to,
+        const Atlas& atlas,
+        int x_from,
+        int y_from,
+        int w,
+        int h);
+
 private:
     void transform_point(int& x, int& y) const;
     void setpixel(int x, int y, PixelColor color);
     void drawline_low(int x0, int y0, int x1, int y1);
     void drawline_high(int x0, int y0, int x1, int y1);
     void drawchar(int x, int y, char c);
-};
-
-struct Rect {
-    int left;
-    int top;
-    int right;
-    int bottom;
+    void blit(
+        int x_to,
+        int y_to,
+        const std::uint8_t* source,
+        int stride,
+        int x_from,
+        int y_from,
+        int w,
+        int h,
+        PixelColor set,
+        PixelColor clear);
 };
 
 class View {
@@ -77,9 +135,18 @@ public:
     Rect bounds;
 
     virtual ~View() = default;
+
+    // Add areas that must be redrawn to show changes since last rendered.  By
+    // default, that's the whole view, every time.
+    virtual void invalidated(const Context&, std::vector<Rect>& rects) { rects.push_back(bounds); }
+
+    // Render view.  Only what lies inside `context.clip` need be drawn, and
+    // that has already been erased.
     virtual void render(Context& context) = 0;
 };
 
+
+
 #endif
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
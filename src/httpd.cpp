@@ -5,14 +5,30 @@
 #include "centaur.h"
 #include "cfg.h"
 #include "chess/chess.h"
+#include "db.h"
 #include "screen.h"
 
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <cstdio>
-
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <jansson.h>
 #include <pcre2.h>
 #include <pthread.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 //
 // Types
@@ -26,6 +42,7 @@ struct HttpdRequest {
     uint8_t               *body;
     size_t                 body_allocated;
     size_t                 body_used;
+    char                  *params;  // Path parameters, see `capture_params`
     void                  *userdata;
 };
 
@@ -43,6 +60,7 @@ void httpd_request_free(struct HttpdRequest *request) {
     if (request->body) {
         free(request->body);
     }
+    free(request->params);
     free(request);
 }
 
@@ -61,6 +79,7 @@ httpd_request_new(
     request->body           = NULL;
     request->body_allocated = 0;
     request->body_used      = 0;
+    request->params         = NULL;
     request->userdata       = NULL;
     return request;
 }
@@ -132,6 +151,20 @@ httpd_request_query_var(const struct HttpdRequest *request, const char *name) {
     return MHD_lookup_connection_value(request->mhd_connection, MHD_GET_ARGUMENT_KIND, name);
 }
 
+const char*
+httpd_request_path_var(const struct HttpdRequest *request, const char *name) {
+    if (request->params) {
+        for (const char *p = request->params; *p; ) {
+            const char *value = p + strlen(p) + 1;
+            if (strcmp(p, name) == 0) {
+                return value;
+            }
+            p = value + strlen(value) + 1;
+        }
+    }
+    return NULL;
+}
+
 static enum MHD_Result
 query_iterator_cb(void *cls, enum MHD_ValueKind kind, const char *name, const char *value)
 {
@@ -206,9 +239,13 @@ void httpd_response_free(struct HttpdResponse *response) {
 }
 
 static struct HttpdResponse*
-httpd_response_new(struct MHD_Response *mhd_response, int status_code) {
+httpd_response_cached(
+    struct MHD_Response *mhd_response,
+    int                  status_code,
+    const char          *cache_control)
+{
     if (mhd_response) {
-        MHD_add_response_header(mhd_response, "Cache-Control", "no-store");
+        MHD_add_response_header(mhd_response, "Cache-Control", cache_control);
     }
     struct HttpdResponse *response = (struct HttpdResponse*)malloc(sizeof *response);
     response->mhd_response = mhd_response;
@@ -216,45 +253,144 @@ httpd_response_new(struct MHD_Response *mhd_response, int status_code) {
     return response;
 }
 
+static struct HttpdResponse*
+httpd_response_new(struct MHD_Response *mhd_response, int status_code) {
+    return httpd_response_cached(mhd_response, status_code, "no-store");
+}
+
 //
 // Handlers
 //
 
-class EventStream : public Observer<Game>, public Observer<Screen> {
-public:
-    std::condition_variable cond;
-    std::mutex              mutex;
-    std::queue<std::string> events;
+// Server-sent events.  Game and screen changes are serialized once, on the
+// game thread, into a ring of recent events numbered in sequence.  Streams read
+// the ring at their own pace, each from its own cursor, taking no lock shared
+// with the game thread, so publishing costs the same however many clients are
+// connected.  A stream that falls a whole ring behind skips ahead, and a client
+// reconnecting with Last-Event-ID resumes where it left off.
+//
+// With a thread per connection, each stream blocks its thread waiting for
+// events.  With an event loop, a stream with nothing to send is suspended
+// instead, and resumed by the waker thread on the next event or keepalive.
+
+static const uint64_t RING_SIZE = 64;
 
-    ~EventStream();
-    EventStream();
+struct Event {
+    uint64_t    id;
+    std::string text;  // Serialized, ready to send
+};
 
+class EventBus : public Observer<Game>, public Observer<Screen> {
+public:
     void on_changed(Game&) override;
     void on_changed(Screen&) override;
+
+    // Serialize event into ring, taking ownership of data.  Called only on the
+    // game thread.
+    void publish(const char *name, json_t *data);
+};
+
+struct EventStream {
+    struct MHD_Connection *connection;
+    uint64_t               next;              // Id of next event to send
+    bool                   suspended{false};  // Waiting for waker
+    bool                   keepalive{false};  // Woken to send keepalive
 };
 
-void EventStream::on_changed(Game&) {
-    std::lock_guard<std::mutex> lock(mutex);
-    events.push("game_changed");
-    cond.notify_one();
+static EventBus                     bus;
+static std::shared_ptr<const Event> ring[RING_SIZE];
+static std::atomic<uint64_t>        ring_head{1};  // Id of next event
+
+static std::mutex              bus_mutex;  // Only to wait for events
+static std::condition_variable bus_cond;
+static bool                    event_loop = false;
+
+static std::mutex             streams_mutex;  // Lock `streams` and `suspended`
+static std::set<EventStream*> streams;
+static std::atomic<bool>      streams_closing{false};
+static std::thread            waker;
+
+void EventBus::publish(const char *name, json_t *data) {
+    json_object_set_new(data, "timestamp", json_integer(time(NULL)));
+    char *json = json_dumps(data, JSON_COMPACT);
+    json_decref(data);
+
+    const uint64_t id = ring_head.load(std::memory_order_relaxed);
+    char *text = NULL;
+    asprintf(&text, "id: %llu\nevent: %s\ndata: %s\n\n", (unsigned long long)id, name, json);
+    free(json);
+
+    auto event = std::make_shared<const Event>(Event{id, text});
+    free(text);
+    std::atomic_store(&ring[id % RING_SIZE], event);
+    {
+        std::lock_guard<std::mutex> lock(bus_mutex);
+        ring_head.store(id + 1, std::memory_order_release);
+    }
+    bus_cond.notify_all();
 }
 
-void EventStream::on_changed(Screen&) {
-    std::lock_guard<std::mutex> lock(mutex);
-    events.push("screen_changed");
-    cond.notify_one();
+// Position after the change, and the move that reached it, if any
+void EventBus::on_changed(Game& game) {
+    json_t *data = json_object();
+    json_object_set_new(data, "fen", json_string(game.fen().data()));
+    json_object_set_new(data, "ply", json_integer(game.history.size() - 1));
+    if (auto previous = game.previous()) {
+        if (auto move = previous->find_move_played(game.current())) {
+            json_object_set_new(data, "uci", json_string(move->uci().data()));
+            json_object_set_new(data, "san", json_string(previous->move_san(*move).data()));
+        }
+    }
+    publish("game_changed", data);
 }
 
-EventStream::~EventStream() {
-    std::lock_guard<std::mutex> lock(mutex);
-    centaur.game->unobserve(this);
-    centaur.screen.unobserve(this);
+void EventBus::on_changed(Screen& screen) {
+    json_t *data = json_object();
+    json_object_set_new(data, "generation", json_integer(screen.generation()));
+    publish("screen_changed", data);
 }
 
-EventStream::EventStream() {
-    std::lock_guard<std::mutex> lock(mutex);
-    centaur.game->observe(this);
-    centaur.screen.observe(this);
+// Wake suspended streams when there are new events, or every 25 s to send
+// keepalive, which also notices clients that have gone away.  On shutdown, wake
+// them all to finish.
+static void wake_streams() {
+    const auto interval = std::chrono::seconds(25);
+    auto keepalive_due  = std::chrono::steady_clock::now() + interval;
+    uint64_t seen = ring_head;
+
+    std::unique_lock<std::mutex> lock(bus_mutex);
+    for (;;) {
+        bus_cond.wait_until(lock, keepalive_due, [&seen]() {
+            return streams_closing || ring_head != seen;
+        });
+        seen = ring_head;
+
+        const bool keepalive = std::chrono::steady_clock::now() >= keepalive_due;
+        if (keepalive) {
+            keepalive_due = std::chrono::steady_clock::now() + interval;
+        }
+
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> streams_lock(streams_mutex);
+            for (auto stream : streams) {
+                if (stream->suspended) {
+                    stream->suspended = false;
+                    stream->keepalive = keepalive;
+                    MHD_resume_connection(stream->connection);
+                }
+            }
+        }
+        if (streams_closing) {
+            break;
+        }
+        lock.lock();
+    }
+}
+
+static ssize_t
+write_keepalive(char *buf, size_t max) {
+    return snprintf(buf, max, "event: keepalive\ndata: {\"timestamp\": %ld}\n\n", time(NULL));
 }
 
 static ssize_t
@@ -262,41 +398,93 @@ stream_events(EventStream *stream, uint64_t pos, char *buf, size_t max)
 {
     (void)pos;
 
-    // Keepalive
-    int rc = snprintf(buf, max, ":\n\n");
+    if (streams_closing) {
+        return MHD_CONTENT_READER_END_OF_STREAM;
+    }
 
-    auto to = std::chrono::system_clock::now() + std::chrono::seconds(25);
+    uint64_t head = ring_head.load(std::memory_order_acquire);
+    if (stream->next >= head && event_loop) {
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        if (stream->keepalive) {
+            stream->keepalive = false;
+            return write_keepalive(buf, max);
+        }
+        head = ring_head.load(std::memory_order_acquire);
+        if (stream->next >= head) {
+            if (streams_closing) {
+                return MHD_CONTENT_READER_END_OF_STREAM;
+            }
+            // Nothing to send, so give up the thread until there is
+            stream->suspended = true;
+            MHD_suspend_connection(stream->connection);
+            return 0;
+        }
+    } else if (stream->next >= head) {
+        std::unique_lock<std::mutex> lock(bus_mutex);
+        const bool woken = bus_cond.wait_for(lock, std::chrono::seconds(25), [&]() {
+            head = ring_head.load(std::memory_order_acquire);
+            return streams_closing || stream->next < head;
+        });
+        if (streams_closing) {
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+        if (!woken) {
+            return write_keepalive(buf, max);
+        }
+    }
 
-    std::unique_lock<std::mutex> lock(stream->mutex);
-    stream->cond.wait_until(lock, to);
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    if (stream->events.empty()) {
-        rc = snprintf(buf, max, "event: keepalive\ndata: {\"timestamp\": %ld}\n\n", ts.tv_sec);
+    // As many events as fit, skipping any already overwritten
+    if (head - stream->next > RING_SIZE) {
+        stream->next = head - RING_SIZE;
     }
-    else {
-        std::string event = stream->events.front();
-        stream->events.pop();
-        rc = snprintf(
-            buf, max, "event: %s\ndata: {\"timestamp\": %ld}\n\n", event.data(), ts.tv_sec);
+    size_t len = 0;
+    while (stream->next < head) {
+        const auto event = std::atomic_load(&ring[stream->next % RING_SIZE]);
+        if (event->id != stream->next) {
+            stream->next = event->id > stream->next ? event->id : stream->next + 1;
+            continue;
+        }
+        if (event->text.size() > max - len) {
+            break;
+        }
+        memcpy(buf + len, event->text.data(), event->text.size());
+        len += event->text.size();
+        ++stream->next;
     }
 
-    return rc;
+    return len > 0 ? (ssize_t)len : write_keepalive(buf, max);
 }
 
 static void stream_free(struct EventStream *stream) {
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        streams.erase(stream);
+    }
     delete stream;
 }
 
+// Resumes after Last-Event-ID if given and still in the ring, else starts with
+// the next event
 static struct HttpdResponse*
 get_events(struct HttpdRequest *request) {
-    (void)request;
+    const uint64_t head = ring_head;
+    uint64_t next = head;
+    if (const char *last = httpd_request_header(request, "Last-Event-ID")) {
+        const uint64_t id = strtoull(last, NULL, 10);
+        if (id < head) {
+            next = id + 1 + RING_SIZE > head ? id + 1 : head - RING_SIZE;
+        }
+    }
 
-    auto stream = new EventStream();
+    auto stream = new EventStream{request->mhd_connection, next};
+    {
+        std::lock_guard<std::mutex> lock(streams_mutex);
+        streams.insert(stream);
+    }
 
     struct MHD_Response *mhd_response = MHD_create_response_from_callback(
         MHD_SIZE_UNKNOWN,
-        1024,
+        4096,
         (MHD_ContentReaderCallback)stream_events,
         stream,
         (MHD_ContentReaderFreeCallback)stream_free);
@@ -319,6 +507,165 @@ get_fen(struct HttpdRequest *request) {
     return httpd_response_new(mhd_response, 200);
 }
 
+static json_t *summary_to_json(const GameSummary& game) {
+    json_t *data = json_object();
+    json_object_set_new(data, "id",     json_integer(game.rowid));
+    json_object_set_new(data, "event",  json_string(game.event.data()));
+    json_object_set_new(data, "site",   json_string(game.site.data()));
+    json_object_set_new(data, "date",   json_string(game.date.data()));
+    json_object_set_new(data, "round",  json_string(game.round.data()));
+    json_object_set_new(data, "white",  json_string(game.white.data()));
+    json_object_set_new(data, "black",  json_string(game.black.data()));
+    json_object_set_new(data, "result", json_string(game.result.data()));
+    return data;
+}
+
+static struct HttpdResponse *json_response(json_t *data) {
+    char *json = json_dumps(data, 0);
+    json_decref(data);
+
+    struct MHD_Response *mhd_response =
+        MHD_create_response_from_buffer(strlen(json), json, MHD_RESPMEM_MUST_FREE);
+    MHD_add_response_header(mhd_response, "Content-Type", "application/json");
+
+    return httpd_response_new(mhd_response, 200);
+}
+
+// Catalogue of saved games, newest first.  Query parameters, all optional:
+// player, result, from and to (PGN dates), before (rowid cursor) and limit.
+// Response includes "next", the cursor for the following page, if any.
+static struct HttpdResponse*
+get_games(struct HttpdRequest *request) {
+    auto var = [request](const char *name) {
+        const char *value = httpd_request_query_var(request, name);
+        return std::string(value ? value : "");
+    };
+
+    GameQuery query;
+    query.player    = var("player");
+    query.result    = var("result");
+    query.date_from = var("from");
+    query.date_to   = var("to");
+    query.before    = atoll(var("before").data());
+    query.limit     = atoi(var("limit").data());
+    if (query.limit <= 0 || query.limit > 100) {
+        query.limit = 50;
+    }
+
+    std::vector<GameSummary> games;
+    if (db.list_games(query, games)) {
+        return NULL;
+    }
+
+    json_t *list = json_array();
+    for (const auto& game : games) {
+        json_array_append_new(list, summary_to_json(game));
+    }
+
+    // Full page suggests there may be more
+    json_t *data = json_object();
+    json_object_set_new(data, "games", list);
+    json_object_set_new(data, "next",
+        games.size() == (size_t)query.limit ? json_integer(games.back().rowid) : json_null());
+
+    return json_response(data);
+}
+
+// Saved game as PGN, by rowid
+static struct HttpdResponse*
+get_game(struct HttpdRequest *request) {
+    const char *id = httpd_request_path_var(request, "id");
+
+    std::unique_ptr<Game> game = id ? db.load_game(atoll(id)) : nullptr;
+    if (!game) {
+        struct MHD_Response *mhd_response =
+            MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        return httpd_response_new(mhd_response, MHD_HTTP_NOT_FOUND);
+    }
+
+    std::string pgn = game->pgn();
+    struct MHD_Response *mhd_response =
+        MHD_create_response_from_buffer(pgn.size(), (void*)pgn.data(), MHD_RESPMEM_MUST_COPY);
+    MHD_add_response_header(mhd_response, "Content-Type", "application/x-chess-pgn");
+
+    return httpd_response_new(mhd_response, 200);
+}
+
+// Saved games reaching position given by `fen`, newest first, with the ply at
+// which each first reached it.  Paginated like /api/games.
+static struct HttpdResponse*
+get_positions(struct HttpdRequest *request) {
+    const char *fen    = httpd_request_query_var(request, "fen");
+    const char *before = httpd_request_query_var(request, "before");
+    const char *limit  = httpd_request_query_var(request, "limit");
+
+    thc::ChessPosition position;
+    if (!fen || !position.Forsyth(fen)) {
+        struct MHD_Response *mhd_response =
+            MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        return httpd_response_new(mhd_response, MHD_HTTP_BAD_REQUEST);
+    }
+
+    int n = limit ? atoi(limit) : 0;
+    if (n <= 0 || n > 100) {
+        n = 50;
+    }
+
+    std::vector<PositionMatch> matches;
+    if (db.find_position(position, before ? atoll(before) : 0, n, matches)) {
+        return NULL;
+    }
+
+    json_t *list = json_array();
+    for (const auto& match : matches) {
+        json_t *each = summary_to_json(match.game);
+        json_object_set_new(each, "ply", json_integer(match.ply));
+        json_array_append_new(list, each);
+    }
+
+    json_t *data = json_object();
+    json_object_set_new(data, "games", list);
+    json_object_set_new(data, "next",
+        matches.size() == (size_t)n ? json_integer(matches.back().game.rowid) : json_null());
+
+    return json_response(data);
+}
+
+// Opening explorer: moves played from position given by `fen` in saved games,
+// most played first, with results.
+static struct HttpdResponse*
+get_openings(struct HttpdRequest *request) {
+    const char *fen = httpd_request_query_var(request, "fen");
+
+    thc::ChessPosition position;
+    if (!fen || !position.Forsyth(fen)) {
+        struct MHD_Response *mhd_response =
+            MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        return httpd_response_new(mhd_response, MHD_HTTP_BAD_REQUEST);
+    }
+
+    std::vector<OpeningMove> moves;
+    if (db.explore(position, moves)) {
+        return NULL;
+    }
+
+    json_t *list = json_array();
+    for (const auto& move : moves) {
+        json_t *each = json_object();
+        json_object_set_new(each, "san",   json_string(position.move_san(move.move).data()));
+        json_object_set_new(each, "uci",   json_string(move.move.uci().data()));
+        json_object_set_new(each, "games", json_integer(move.games));
+        json_object_set_new(each, "white", json_integer(move.white));
+        json_object_set_new(each, "draws", json_integer(move.draws));
+        json_object_set_new(each, "black", json_integer(move.black));
+        json_array_append_new(list, each);
+    }
+
+    json_t *data = json_object();
+    json_object_set_new(data, "moves", list);
+    return json_response(data);
+}
+
 static struct HttpdResponse*
 get_pgn(struct HttpdRequest *request) {
     (void)request;
@@ -333,19 +680,227 @@ get_pgn(struct HttpdRequest *request) {
     return httpd_response_new(mhd_response, 200);
 }
 
+// True if If-None-Match lists etag, or is a wildcard
+static bool etag_matches(const char *if_none_match, const char *etag) {
+    if (!if_none_match) {
+        return false;
+    }
+    if (strcmp(if_none_match, "*") == 0) {
+        return true;
+    }
+    const size_t len = strlen(etag);
+    for (const char *p = strstr(if_none_match, etag); p; p = strstr(p + 1, etag)) {
+        const char end = p[len];
+        if (end == '\0' || end == ',' || end == ' ') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Display image, as PNG, or raw 1-bpp bitmap with ?format=raw.  Encoded images
+// are cached by Screen, and ETag lets clients revalidate without downloading
+// it again.  Screen generations start over on restart, so the ETag also
+// includes a timestamp fixed when the process first serves the screen.
 static struct HttpdResponse*
 get_screen(struct HttpdRequest *request) {
-    (void)request;
+    static const time_t epoch = time(NULL);
+
+    const char *format_var = httpd_request_query_var(request, "format");
+    ScreenFormat format = SCREEN_PNG;
+    if (format_var && strcmp(format_var, "raw") == 0) {
+        format = SCREEN_RAW;
+    } else if (format_var && strcmp(format_var, "png") != 0) {
+        struct MHD_Response *mhd_response =
+            MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        return httpd_response_new(mhd_response, MHD_HTTP_BAD_REQUEST);
+    }
 
-    uint8_t *png  = NULL;
-    size_t   size = 0;
-    centaur.screen.png(&png, &size);
+    const auto frame = centaur.screen.frame(format);
+    if (!frame) {
+        return NULL;
+    }
 
-    struct MHD_Response *mhd_response =
-        MHD_create_response_from_buffer(size, png, MHD_RESPMEM_MUST_FREE);
-    MHD_add_response_header(mhd_response, "Content-Type", "image/png");
+    char etag[64];
+    snprintf(etag, sizeof etag, "\"%llx-%llx-%s\"",
+        (unsigned long long)epoch,
+        (unsigned long long)frame->generation,
+        format == SCREEN_RAW ? "raw" : "png");
 
-    return httpd_response_new(mhd_response, 200);
+    struct MHD_Response *mhd_response;
+    int status_code;
+    if (etag_matches(httpd_request_header(request, "If-None-Match"), etag)) {
+        mhd_response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        status_code  = MHD_HTTP_NOT_MODIFIED;
+    } else {
+        mhd_response = MHD_create_response_from_buffer(
+            frame->data.size(), (void*)frame->data.data(), MHD_RESPMEM_MUST_COPY);
+        status_code  = 200;
+        if (format == SCREEN_RAW) {
+            char dimension[16];
+            MHD_add_response_header(mhd_response, "Content-Type", "application/octet-stream");
+            snprintf(dimension, sizeof dimension, "%d", SCREEN_WIDTH);
+            MHD_add_response_header(mhd_response, "X-Screen-Width", dimension);
+            snprintf(dimension, sizeof dimension, "%d", SCREEN_HEIGHT);
+            MHD_add_response_header(mhd_response, "X-Screen-Height", dimension);
+        } else {
+            MHD_add_response_header(mhd_response, "Content-Type", "image/png");
+        }
+    }
+    MHD_add_response_header(mhd_response, "ETag", etag);
+
+    return httpd_response_cached(mhd_response, status_code, "no-cache");
+}
+
+// Built web app.  Vite names assets by content hash, so those can be cached
+// forever.  Anything else, e.g., index.html, must be revalidated, by ETag.
+// Where the build also produced a Brotli- or gzip-compressed copy, and the
+// browser accepts it, we send that instead.  Files are sent by descriptor,
+// letting MHD use sendfile.
+
+static const struct {
+    const char *extension;
+    const char *content_type;
+} content_types[] = {
+    {".css",   "text/css"},
+    {".html",  "text/html; charset=utf-8"},
+    {".ico",   "image/x-icon"},
+    {".js",    "text/javascript"},
+    {".json",  "application/json"},
+    {".map",   "application/json"},
+    {".png",   "image/png"},
+    {".svg",   "image/svg+xml"},
+    {".txt",   "text/plain; charset=utf-8"},
+    {".woff2", "font/woff2"},
+};
+
+static const char *content_type(const char *path) {
+    const char *extension = strrchr(path, '.');
+    if (extension && !strchr(extension, '/')) {
+        for (const auto& type : content_types) {
+            if (strcmp(extension, type.extension) == 0) {
+                return type.content_type;
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+// E.g., /assets/index-4f2a9c1B.js
+static bool is_hashed(const char *path) {
+    if (strncmp(path, "/assets/", 8) != 0) {
+        return false;
+    }
+    const char *extension = strrchr(path, '.');
+    const char *dash      = strrchr(path, '-');
+    if (!extension || !dash || extension - dash != 9) {
+        return false;
+    }
+    for (const char *p = dash + 1; p != extension; ++p) {
+        if (!isalnum((unsigned char)*p) && *p != '_' && *p != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True if Accept-Encoding lists coding, other than with q=0
+static bool accepts_encoding(const char *accept_encoding, const char *coding) {
+    if (!accept_encoding) {
+        return false;
+    }
+    const size_t len = strlen(coding);
+    for (const char *p = accept_encoding; *p; ) {
+        p += strspn(p, " \t,");
+        const size_t token = strcspn(p, " \t,;");
+        const char *end = p + strcspn(p, ",");
+        if (token == len && strncasecmp(p, coding, len) == 0) {
+            const char *q = strstr(p, "q=");
+            return !(q && q < end && strtod(q + 2, NULL) == 0);
+        }
+        p = end;
+    }
+    return false;
+}
+
+static struct HttpdResponse*
+get_static(struct HttpdRequest *request) {
+    const char *url = httpd_request_url(request);
+    if (url[0] != '/' || strstr(url, "/.")) {
+        struct MHD_Response *mhd_response =
+            MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        return httpd_response_new(mhd_response, MHD_HTTP_NOT_FOUND);
+    }
+
+    const bool is_index = strcmp(url, "/") == 0;
+    std::string path = cfg_www_dir();
+    path += is_index ? "/index.html" : url;
+
+    static const struct {
+        const char *coding;
+        const char *suffix;
+    } encodings[] = {
+        {"br",   ".br"},
+        {"gzip", ".gz"},
+        {NULL,   ""},
+    };
+
+    const char *accept_encoding = httpd_request_header(request, "Accept-Encoding");
+    int fd = -1;
+    struct stat st;
+    const char *coding = NULL;
+    for (const auto& encoding : encodings) {
+        if (encoding.coding && !accepts_encoding(accept_encoding, encoding.coding)) {
+            continue;
+        }
+        fd = open((path + encoding.suffix).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            coding = encoding.coding;
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) {
+        struct MHD_Response *mhd_response =
+            MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        return httpd_response_new(mhd_response, MHD_HTTP_NOT_FOUND);
+    }
+
+    // Differs between encodings, as the content does
+    char etag[64];
+    snprintf(etag, sizeof etag, "\"%llx-%llx-%s\"",
+        (unsigned long long)st.st_mtime,
+        (unsigned long long)st.st_size,
+        coding ? coding : "identity");
+
+    struct MHD_Response *mhd_response;
+    int status_code;
+    if (etag_matches(httpd_request_header(request, "If-None-Match"), etag)) {
+        close(fd);
+        mhd_response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        status_code  = MHD_HTTP_NOT_MODIFIED;
+    } else {
+        // Takes ownership of fd
+        mhd_response = MHD_create_response_from_fd(st.st_size, fd);
+        if (!mhd_response) {
+            close(fd);
+            return NULL;
+        }
+        status_code = 200;
+        MHD_add_response_header(mhd_response, "Content-Type", content_type(path.c_str()));
+        if (coding) {
+            MHD_add_response_header(mhd_response, "Content-Encoding", coding);
+        }
+    }
+    MHD_add_response_header(mhd_response, "ETag", etag);
+    MHD_add_response_header(mhd_response, "Vary", "Accept-Encoding");
+
+    return httpd_response_cached(mhd_response, status_code,
+        is_hashed(url) ? "public, max-age=31536000, immutable" : "no-cache");
 }
 
 //
@@ -375,14 +930,20 @@ struct Endpoint {
     HttpdRequestHandler handler;
 };
 
-#define NUM_ENDPOINTS 4
+#define NUM_ENDPOINTS 9
 
+// First match wins, so more specific patterns come first
 static const struct Endpoint
 endpoints[NUM_ENDPOINTS] = {
-    {"/api/events", MATCH_PREFIX, METHOD_GET, get_events},
-    {"/api/fen",    MATCH_PREFIX, METHOD_GET, get_fen},
-    {"/api/pgn",    MATCH_PREFIX, METHOD_GET, get_pgn},
-    {"/api/screen", MATCH_PREFIX, METHOD_GET, get_screen},
+    {"/api/events",                  MATCH_PREFIX, METHOD_GET, get_events},
+    {"/api/fen",                     MATCH_PREFIX, METHOD_GET, get_fen},
+    {"^/api/games/(?<id>[0-9]+)$",   MATCH_REGEX,  METHOD_GET, get_game},
+    {"/api/games",                   MATCH_PREFIX, METHOD_GET, get_games},
+    {"/api/openings",                MATCH_PREFIX, METHOD_GET, get_openings},
+    {"/api/pgn",                     MATCH_PREFIX, METHOD_GET, get_pgn},
+    {"/api/positions",               MATCH_PREFIX, METHOD_GET, get_positions},
+    {"/api/screen",                  MATCH_PREFIX, METHOD_GET, get_screen},
+    {"/",                            MATCH_PREFIX, METHOD_GET, get_static},
 };
 
 static enum Method
@@ -410,85 +971,179 @@ encode_method(const char *method)
     return METHOD_UNDEFINED;
 }
 
-static bool
-match_prefix(const char *pattern, const char *url)
-{
-    return strncmp(pattern, url, strlen(pattern)) == 0;
-}
+//
+// Routing
+//
+// Routes are compiled once, when the daemon starts: prefix patterns into a trie
+// over URL characters, and regular expressions with JIT.  As before, the first
+// endpoint in the table matching both URL and method handles the request.
+//
 
-static bool
-match_regex(const char *pattern, const char *url)
-{
-    int err_code;
-    PCRE2_SIZE err_offset;
+struct TrieNode {
+    std::map<char, int> children;   // Index into `trie`
+    std::vector<int>    endpoints;  // Prefix patterns ending here
+};
 
-    pcre2_code *re = pcre2_compile(
-        (PCRE2_SPTR)pattern,
-        PCRE2_ZERO_TERMINATED,
-        0,
-        &err_code,
-        &err_offset,
-        NULL);
+static std::vector<TrieNode> trie;
+static pcre2_code *regexes[NUM_ENDPOINTS];
 
-    pcre2_match_data *md = NULL;
-    if (re) {
-        md = pcre2_match_data_create_from_pattern(re, NULL);
-    }
+// Enough for captures of any pattern
+static uint32_t capture_pairs = 1;
 
-    int rc = 0;
-    if (md) {
-        rc = pcre2_match(re, (PCRE2_SPTR)url, PCRE2_ZERO_TERMINATED, 0, 0, md, NULL);
+// Match data, one per thread, freed when thread exits
+struct MatchData {
+    pcre2_match_data *md{NULL};
+    ~MatchData() {
+        if (md) {
+            pcre2_match_data_free(md);
+        }
     }
+};
 
-    if (md) {
-        pcre2_match_data_free(md);
+static int
+compile_routes(void)
+{
+    trie.assign(1, TrieNode{});
+    for (int i = 0; i != NUM_ENDPOINTS; ++i) {
+        const struct Endpoint *endpoint = &endpoints[i];
+        switch (endpoint->match) {
+        case MATCH_PREFIX: {
+            int node = 0;
+            for (const char *c = endpoint->pattern; *c; ++c) {
+                auto child = trie[node].children.find(*c);
+                if (child != trie[node].children.end()) {
+                    node = child->second;
+                    continue;
+                }
+                trie.emplace_back();
+                trie[node].children[*c] = (int)trie.size() - 1;
+                node = (int)trie.size() - 1;
+            }
+            trie[node].endpoints.push_back(i);
+            break;
+        }
+        case MATCH_REGEX: {
+            int err_code;
+            PCRE2_SIZE err_offset;
+            regexes[i] = pcre2_compile(
+                (PCRE2_SPTR)endpoint->pattern,
+                PCRE2_ZERO_TERMINATED,
+                0,
+                &err_code,
+                &err_offset,
+                NULL);
+            if (!regexes[i]) {
+                fprintf(stderr, "Invalid route: %s\n", endpoint->pattern);
+                return 1;
+            }
+            pcre2_jit_compile(regexes[i], PCRE2_JIT_COMPLETE);  // Else interpreted
+
+            uint32_t captures = 0;
+            pcre2_pattern_info(regexes[i], PCRE2_INFO_CAPTURECOUNT, &captures);
+            if (captures + 1 > capture_pairs) {
+                capture_pairs = captures + 1;
+            }
+            break;
+        }
+        default:
+            assert(0);
+        }
     }
+    return 0;
+}
 
-    if (re) {
-        pcre2_code_free(re);
+static void
+free_routes(void)
+{
+    for (int i = 0; i != NUM_ENDPOINTS; ++i) {
+        if (regexes[i]) {
+            pcre2_code_free(regexes[i]);
+            regexes[i] = NULL;
+        }
     }
-
-    return rc > 0;
+    trie.clear();
 }
 
-static bool
-match_endpoint(const struct Endpoint *endpoint, const char *url)
+// Copy named captures as consecutive strings: name, value, ..., then empty.
+static char*
+capture_params(const pcre2_code *re, pcre2_match_data *md, const char *url)
 {
-    bool result = false;
-
-    switch (endpoint->match) {
-    case MATCH_PREFIX:
-        result = match_prefix(endpoint->pattern, url);
-        break;
-    case MATCH_REGEX:
-        result = match_regex(endpoint->pattern, url);
-        break;
-    default:
-        assert(0);
+    uint32_t count;
+    uint32_t entry_size;
+    PCRE2_SPTR table;
+    pcre2_pattern_info(re, PCRE2_INFO_NAMECOUNT, &count);
+    if (count == 0) {
+        return NULL;
+    }
+    pcre2_pattern_info(re, PCRE2_INFO_NAMEENTRYSIZE, &entry_size);
+    pcre2_pattern_info(re, PCRE2_INFO_NAMETABLE, &table);
+
+    const PCRE2_SIZE *ovector = pcre2_get_ovector_pointer(md);
+    std::string params;
+    for (uint32_t i = 0; i != count; ++i) {
+        PCRE2_SPTR entry = table + i * entry_size;
+        const int n = (entry[0] << 8) | entry[1];
+        if (ovector[2 * n] == PCRE2_UNSET) {
+            continue;
+        }
+        params += (const char*)(entry + 2);
+        params += '\0';
+        params.append(url + ovector[2 * n], ovector[2 * n + 1] - ovector[2 * n]);
+        params += '\0';
     }
 
+    char *result = (char*)malloc(params.size() + 1);
+    memcpy(result, params.data(), params.size());
+    result[params.size()] = 0;
     return result;
 }
 
-
 static void
 lookup_endpoint(
-    const struct Endpoint  *lookup_table,
-    int                     lookup_table_size,
     const char             *url,
     const char             *method,
-    const struct Endpoint **endpoint)
+    const struct Endpoint **endpoint,
+    char                  **params)
 {
     const enum Method meth = encode_method(method);
+    auto allowed = [meth](int i) { return (endpoints[i].method & meth) == meth; };
+
+    // Earliest prefix match, as the trie may yield them out of order
+    int best = NUM_ENDPOINTS;
+    for (int node = 0, depth = 0; node >= 0; ++depth) {
+        for (int i : trie[node].endpoints) {
+            if (i < best && allowed(i)) {
+                best = i;
+            }
+        }
+        if (!url[depth]) {
+            break;
+        }
+        auto child = trie[node].children.find(url[depth]);
+        node = child != trie[node].children.end() ? child->second : -1;
+    }
 
-    for (int i = 0; i != lookup_table_size; ++i) {
-        if ((lookup_table[i].method & meth) == meth &&
-            match_endpoint(&lookup_table[i], url))
+    // Any earlier regular expression
+    static thread_local MatchData match_data;
+    for (int i = 0; i < best; ++i) {
+        if (!regexes[i] || !allowed(i)) {
+            continue;
+        }
+        if (!match_data.md) {
+            match_data.md = pcre2_match_data_create(capture_pairs, NULL);
+        }
+        if (pcre2_match(regexes[i], (PCRE2_SPTR)url, PCRE2_ZERO_TERMINATED, 0, 0,
+                        match_data.md, NULL) > 0)
         {
-            *endpoint = &lookup_table[i];
-            return;
+            best = i;
+            *params = capture_params(regexes[i], match_data.md, url);
+            break;
         }
     }
+
+    if (best < NUM_ENDPOINTS) {
+        *endpoint = &endpoints[best];
+    }
 }
 
 static enum MHD_Result
@@ -508,7 +1163,8 @@ handle_headers(
     (void)upload_data_size;
 
     const struct Endpoint *endpoint = NULL;
-    lookup_endpoint(endpoints, NUM_ENDPOINTS, url, method, &endpoint);
+    char *params = NULL;
+    lookup_endpoint(url, method, &endpoint, &params);
 
     struct HttpdRequest *request = NULL;
     if (endpoint) {
@@ -517,6 +1173,7 @@ handle_headers(
             method,
             url,
             endpoint->handler);
+        request->params = params;
         *con_cls = request;
     }
     if (request) {
@@ -643,26 +1300,75 @@ handle_completed(
 static struct MHD_Daemon *httpd_daemon = NULL;
 
 void httpd_stop() {
+    // Wake streams to finish, as daemon waits for them
+    {
+        std::lock_guard<std::mutex> lock(bus_mutex);
+        streams_closing = true;
+    }
+    bus_cond.notify_all();
+    if (waker.joinable()) {
+        waker.join();
+    }
+    centaur.unobserve_game(&bus);
+    centaur.screen.unobserve(&bus);
+
     if (httpd_daemon) {
         MHD_stop_daemon(httpd_daemon);
         httpd_daemon = NULL;
     }
+    free_routes();
 }
 
+// Either a pool of threads each running an epoll loop, or (with no pool) a
+// thread per connection.  Event streams hold a thread only in the latter.
 int httpd_start() {
-    const int port = cfg_port();
-    httpd_daemon = MHD_start_daemon(
-        MHD_USE_THREAD_PER_CONNECTION,
-        port,
-        NULL,
-        NULL,
-        handle_connection,
-        NULL,
-        MHD_OPTION_NOTIFY_COMPLETED,
-        handle_completed,
-        NULL,
-        MHD_OPTION_END);
-    return httpd_daemon ? 0 : 1;
+    const int port    = cfg_port();
+    const int threads = cfg_httpd_threads();
+
+    if (compile_routes()) {
+        free_routes();
+        return 1;
+    }
+
+    event_loop      = threads > 0;
+    streams_closing = false;
+    if (event_loop) {
+        httpd_daemon = MHD_start_daemon(
+            MHD_USE_EPOLL_INTERNAL_THREAD | MHD_ALLOW_SUSPEND_RESUME,
+            port,
+            NULL,
+            NULL,
+            handle_connection,
+            NULL,
+            MHD_OPTION_NOTIFY_COMPLETED,
+            handle_completed,
+            NULL,
+            MHD_OPTION_THREAD_POOL_SIZE,
+            (unsigned int)threads,
+            MHD_OPTION_END);
+    } else {
+        httpd_daemon = MHD_start_daemon(
+            MHD_USE_THREAD_PER_CONNECTION,
+            port,
+            NULL,
+            NULL,
+            handle_connection,
+            NULL,
+            MHD_OPTION_NOTIFY_COMPLETED,
+            handle_completed,
+            NULL,
+            MHD_OPTION_END);
+    }
+    if (!httpd_daemon) {
+        return 1;
+    }
+
+    centaur.observe_game(&bus);
+    centaur.screen.observe(&bus);
+    if (event_loop) {
+        waker = std::thread(wake_streams);
+    }
+    return 0;
 }
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
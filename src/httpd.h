@@ -58,6 +58,10 @@ const char *httpd_request_content_type(const struct HttpdRequest*);
 const char*
 httpd_request_query_var(const struct HttpdRequest*, const char *name);
 
+// Named capture from endpoint's pattern, for MATCH_REGEX endpoints
+const char*
+httpd_request_path_var(const struct HttpdRequest*, const char *name);
+
 void
 httpd_request_query_string(const struct HttpdRequest*, char**);
 
@@ -3,10 +3,13 @@
 
 #include "image.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
 #include <png.h>
 
@@ -202,6 +205,353 @@ int Image::png(uint8_t** png, size_t* size) const {
     return 0;
 }
 
+//
+// PNG encoder specialised for bilevel images
+//
+// Our images are always 1-bpp grayscale, and mostly white, so we skip libpng
+// and zlib.  Rows are filtered with None or Up, whichever leaves longer runs,
+// then compressed with fixed-Huffman deflate, looking for matches only at a
+// few fixed distances: runs of the same byte, repeats of the rows just above,
+// and repeats of the board squares to the left and above.  If that fails to beat the uncompressed size, we store the rows
+// uncompressed instead.
+//
+
+namespace {
+
+constexpr array<uint32_t, 256> make_crc_table() {
+    array<uint32_t, 256> table{};
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+    return table;
+}
+
+constexpr auto CRC_TABLE = make_crc_table();
+
+uint32_t crc32(const uint8_t* p, size_t n) {
+    uint32_t c = 0xffffffffu;
+    while (n--) {
+        c = CRC_TABLE[(c ^ *p++) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+uint32_t adler32(const uint8_t* p, size_t n) {
+    uint32_t a = 1, b = 0;
+    while (n) {
+        // Largest block that can't overflow before reducing modulo 65521
+        auto block = min<size_t>(n, 5552);
+        n -= block;
+        while (block--) {
+            a += *p++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+uint8_t* put32(uint8_t* p, uint32_t value) {
+    *p++ = value >> 24;
+    *p++ = value >> 16;
+    *p++ = value >>  8;
+    *p++ = value;
+    return p;
+}
+
+// Deflate writes Huffman codes most significant bit first, but packs bits
+// into bytes least significant bit first, so codes are stored reversed.
+constexpr uint16_t reverse_bits(uint16_t code, int n) {
+    uint16_t result = 0;
+    for (int i = 0; i < n; ++i) {
+        result = result << 1 | (code >> i & 1);
+    }
+    return result;
+}
+
+struct Code {
+    uint16_t bits;
+    uint8_t  n;
+};
+
+// Fixed literal/length codes (RFC 1951, 3.2.6)
+constexpr array<Code, 288> make_literal_codes() {
+    array<Code, 288> codes{};
+    for (int v = 0; v < 288; ++v) {
+        if (v < 144) {
+            codes[v] = {reverse_bits(0x30 + v, 8), 8};
+        } else if (v < 256) {
+            codes[v] = {reverse_bits(0x190 + v - 144, 9), 9};
+        } else if (v < 280) {
+            codes[v] = {reverse_bits(v - 256, 7), 7};
+        } else {
+            codes[v] = {reverse_bits(0xc0 + v - 280, 8), 8};
+        }
+    }
+    return codes;
+}
+
+constexpr auto LITERAL_CODES = make_literal_codes();
+
+constexpr uint16_t LENGTH_BASE[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+constexpr uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+constexpr uint16_t DISTANCE_BASE[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+constexpr uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+// Length symbol (less 257) for each match length
+constexpr array<uint8_t, 259> make_length_symbols() {
+    array<uint8_t, 259> symbols{};
+    int symbol = 0;
+    for (int length = 3; length <= 258; ++length) {
+        while (symbol < 28 && LENGTH_BASE[symbol + 1] <= length) {
+            ++symbol;
+        }
+        symbols[length] = symbol;
+    }
+    return symbols;
+}
+
+constexpr auto LENGTH_SYMBOLS = make_length_symbols();
+
+constexpr int MIN_MATCH   = 3;
+constexpr int MAX_MATCH   = 258;
+constexpr int MAX_STORED  = 65535;
+constexpr int MAX_WINDOW  = 32768;
+constexpr int FILTER_NONE = 0;
+constexpr int FILTER_UP   = 2;
+
+class BitWriter {
+public:
+    uint8_t* out;
+    uint8_t* end;
+    bool     overflow{false};
+
+    BitWriter(uint8_t* out, uint8_t* end) : out{out}, end{end} {}
+
+    void put(uint32_t value, int n) {
+        bits  |= uint64_t(value) << count;
+        count += n;
+        while (count >= 8) {
+            if (out == end) {
+                overflow = true;
+                return;
+            }
+            *out++  = uint8_t(bits);
+            bits  >>= 8;
+            count  -= 8;
+        }
+    }
+
+    void put(Code code) {
+        put(code.bits, code.n);
+    }
+
+    // Pad to byte boundary
+    void flush() {
+        if (count > 0) {
+            put(0, 8 - count);
+        }
+    }
+
+private:
+    uint64_t bits{0};
+    int      count{0};
+};
+
+// Number of places output changes from one byte to the next
+int breaks(const uint8_t* row, int n) {
+    int result = 0;
+    for (int x = 1; x < n; ++x) {
+        result += row[x] != row[x - 1];
+    }
+    return result;
+}
+
+// Fixed-Huffman deflate, returning false if output doesn't fit
+bool deflate_fixed(const uint8_t* data, int size, int stride, uint8_t*& out, uint8_t* end) {
+    // Runs, and repeats of the row above, or of the board square (16 pixels)
+    // of the same color, two squares left or above.  Not ascending for narrow
+    // images, and rows of very wide images may be too far apart to reach.
+    const int distances[] = {1, 4, stride, 2 * stride, 32 * stride};
+
+    BitWriter writer{out, end};
+    writer.put(1, 1);  // Final block
+    writer.put(1, 2);  // Fixed Huffman codes
+
+    for (int i = 0; i < size && !writer.overflow;) {
+        const auto limit  = min(MAX_MATCH, size - i);
+        int best_length   = MIN_MATCH - 1;
+        int best_distance = 0;
+        for (const auto distance : distances) {
+            if (best_length >= limit) {
+                break;
+            }
+            if (distance > i || distance > MAX_WINDOW) {
+                continue;
+            }
+            // Can't be longer unless it matches at the end of the best so far
+            const auto from = data + i - distance;
+            if (from[best_length] != data[i + best_length]) {
+                continue;
+            }
+            int length = 0;
+            while (length < limit && data[i + length] == from[length]) {
+                ++length;
+            }
+            if (length > best_length) {
+                best_length   = length;
+                best_distance = distance;
+            }
+        }
+
+        if (!best_distance) {
+            writer.put(LITERAL_CODES[data[i++]]);
+            continue;
+        }
+
+        const auto symbol = LENGTH_SYMBOLS[best_length];
+        writer.put(LITERAL_CODES[257 + symbol]);
+        writer.put(best_length - LENGTH_BASE[symbol], LENGTH_EXTRA[symbol]);
+
+        int code = 29;
+        while (DISTANCE_BASE[code] > best_distance) {
+            --code;
+        }
+        writer.put(reverse_bits(code, 5), 5);
+        writer.put(best_distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+
+        i += best_length;
+    }
+
+    writer.put(LITERAL_CODES[256]);  // End of block
+    writer.flush();
+    if (writer.overflow) {
+        return false;
+    }
+    out = writer.out;
+    return true;
+}
+
+uint8_t* deflate_stored(const uint8_t* data, int size, uint8_t* out) {
+    do {
+        const int block = min(size, MAX_STORED);
+        size -= block;
+        *out++ = size == 0;  // Final block, no compression
+        *out++ = block;
+        *out++ = block >> 8;
+        *out++ = ~block;
+        *out++ = ~block >> 8;
+        memcpy(out, data, block);
+        out  += block;
+        data += block;
+    } while (size > 0);
+    return out;
+}
+
+}
+
+size_t Image::png_bound() const {
+    const size_t filtered = size_t(width_bytes + 1) * height;
+    const size_t blocks   = (filtered + MAX_STORED - 1) / MAX_STORED;
+    return
+        8 +                 // Signature
+        12 + 13 +           // IHDR
+        12 + 2 +            // IDAT, zlib header
+        filtered + 5 * blocks +
+        4 +                 // Adler-32
+        12;                 // IEND
+}
+
+size_t Image::png(uint8_t* png, size_t capacity) const {
+    assert(is_valid());
+    if (capacity < png_bound()) {
+        return 0;
+    }
+
+    static const uint8_t SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    auto out = png;
+    memcpy(out, SIGNATURE, sizeof SIGNATURE);
+    out += sizeof SIGNATURE;
+
+    auto chunk = out;
+    out = put32(out, 13);
+    memcpy(out, "IHDR", 4);
+    out  += 4;
+    out   = put32(out, width);
+    out   = put32(out, height);
+    *out++ = 1;  // Bit depth
+    *out++ = 0;  // Grayscale
+    *out++ = 0;  // Deflate
+    *out++ = 0;  // Adaptive filtering
+    *out++ = 0;  // Not interlaced
+    out = put32(out, crc32(chunk + 4, out - chunk - 4));
+
+    // White is all ones, so a blank row is a run with filter None, as is any
+    // row repeating the one above it with filter Up.
+    const int stride        = width_bytes + 1;
+    const int filtered_size = stride * height;
+    vector<uint8_t> filtered_rows(filtered_size);
+    vector<uint8_t> up(width_bytes);
+    const auto filtered = filtered_rows.data();
+    for (auto y = 0; y < height; ++y) {
+        const auto row  = data() + y * width_bytes;
+        const auto line = filtered + y * stride;
+        line[0] = FILTER_NONE;
+        memcpy(line + 1, row, width_bytes);
+        if (y == 0) {
+            continue;
+        }
+
+        const auto above = row - width_bytes;
+        for (auto x = 0; x < width_bytes; ++x) {
+            up[x] = row[x] - above[x];
+        }
+        if (breaks(up.data(), width_bytes) < breaks(row, width_bytes)) {
+            line[0] = FILTER_UP;
+            memcpy(line + 1, up.data(), width_bytes);
+        }
+    }
+
+    chunk = out;
+    out += 4;
+    memcpy(out, "IDAT", 4);
+    out += 4;
+    *out++ = 0x78;  // Deflate, 32K window
+    *out++ = 0x01;  // Fastest
+    const auto stored_end = out + filtered_size + 5 * ((filtered_size + MAX_STORED - 1) / MAX_STORED);
+    if (!deflate_fixed(filtered, filtered_size, stride, out, stored_end)) {
+        out = deflate_stored(filtered, filtered_size, out);
+    }
+    out = put32(out, adler32(filtered, filtered_size));
+    put32(chunk, out - chunk - 8);
+    out = put32(out, crc32(chunk + 4, out - chunk - 4));
+
+    out = put32(out, 0);
+    memcpy(out, "IEND", 4);
+    out += 4;
+    out = put32(out, crc32(out - 4, 4));
+
+    assert(size_t(out - png) <= capacity);
+    return out - png;
+}
+
 // This file is part of the Raccoon's Centaur Mods (RCM).
 //
 // RCM is free software: you can redistribute it and/or modify
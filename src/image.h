@@ -31,7 +31,13 @@ public:
     const std::uint8_t* data() const { return data_.data(); }
     std::uint8_t* data() { return data_.data(); }
 
+    // Encode PNG with libpng into a newly allocated buffer
     int png(std::uint8_t** png, std::size_t* size) const;
+
+    // Encode PNG into caller's buffer, which must hold at least `png_bound()`
+    // bytes.  Returns size of PNG, or 0 if buffer is too small.
+    std::size_t png(std::uint8_t* png, std::size_t capacity) const;
+    std::size_t png_bound() const;
 };
 
 bool operator==(const Image &a, const Image &b);
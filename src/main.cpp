@@ -1,9 +1,14 @@
 // Copyright (C) 2024 Eric Sessoms
 // See license at end of file
 
+#include "db.h"
 #include "httpd.h"
 #include "standard.h"
 
+// Defined here rather than in db.cpp, so that tools sharing db.cpp, e.g.,
+// pgn_import, don't open the board's database at startup
+Database db;
+
 int main() {
     // Optional, can ignore failure
     (void)httpd_start();
@@ -0,0 +1,138 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Generate atlases of chess pieces and font glyphs, rotated to match the
+// screen, as C++ source.  Run by the build, so the board needn't parse bitmaps
+// or rotate pixels at runtime.
+//
+// usage: make_atlas pieces.bmp atlas_data.cpp
+
+#include "fonts/fonts.h"
+#include "image.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// As Screen
+static const int ROTATE = 180;
+
+static const int NUM_GLYPHS = '~' - ' ' + 1;
+
+// Pixel of source, true if background
+using Pixel = function<bool(int x, int y)>;
+
+struct Layout {
+    const char* name;
+    int width;
+    int height;
+    int cell_width;
+    int cell_height;
+};
+
+static void write_atlas(FILE* out, const Layout& layout, const Pixel& pixel, bool is_static) {
+    const auto width_bytes = (layout.width + 7) / 8;
+    vector<uint8_t> data(width_bytes * layout.height, 0xff);
+
+    for (auto y = 0; y < layout.height; ++y) {
+        for (auto x = 0; x < layout.width; ++x) {
+            // Rotate 180 degrees within cell
+            const auto cell_x = x - x % layout.cell_width;
+            const auto cell_y = y - y % layout.cell_height;
+            const auto x_src  = 2 * cell_x + layout.cell_width  - 1 - x;
+            const auto y_src  = 2 * cell_y + layout.cell_height - 1 - y;
+            if (!pixel(x_src, y_src)) {
+                data[y * width_bytes + x / 8] &= ~(0x80 >> (x % 8));
+            }
+        }
+    }
+
+    fprintf(out, "static constexpr std::uint8_t %s_DATA[] = {", layout.name);
+    for (size_t i = 0; i < data.size(); ++i) {
+        fprintf(out, "%s0x%02x,", i % width_bytes ? " " : "\n    ", data[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "%sconst Atlas %s_ATLAS = {\n", is_static ? "static " : "", layout.name);
+    fprintf(out, "    %s_DATA, %d, %d, %d, %d, %d, %d,\n",
+        layout.name, layout.width, layout.height, width_bytes, ROTATE,
+        layout.cell_width, layout.cell_height);
+    fprintf(out, "};\n\n");
+}
+
+static void write_font(FILE* out, const char* name, const sFONT& font) {
+    const auto stride = font.Width / 8 + (font.Width % 8 ? 1 : 0);
+    const Layout layout{name, font.Width, font.Height * NUM_GLYPHS, font.Width, font.Height};
+    write_atlas(out, layout, [&](int x, int y) {
+        return !(font.table[y * stride + x / 8] & (0x80 >> (x % 8)));
+    }, true);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s pieces.bmp atlas_data.cpp\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const auto pieces = Image::readbmp(argv[1]);
+    if (!pieces) {
+        fprintf(stderr, "%s: failed to load %s\n", argv[0], argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    const auto path = string{argv[2]};
+    const auto temp = path + ".tmp";
+    auto out = fopen(temp.c_str(), "w");
+    if (!out) {
+        perror(temp.c_str());
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "// Generated by make_atlas from %s.  Do not edit.\n\n", argv[1]);
+    fprintf(out, "#include \"atlas.h\"\n\n");
+
+    const Layout layout{"PIECES", pieces->width, pieces->height, 16, 16};
+    write_atlas(out, layout, [&](int x, int y) {
+        return pieces->data_[y * pieces->width_bytes + x / 8] & (0x80 >> (x % 8));
+    }, false);
+
+    write_font(out, "FONT12", Font12);
+    write_font(out, "FONT16", Font16);
+    write_font(out, "FONT20", Font20);
+    write_font(out, "FONT24", Font24);
+
+    fprintf(out,
+        "const Atlas* font_atlas(const sFONT* font) {\n"
+        "    if (font == &Font12) return &FONT12_ATLAS;\n"
+        "    if (font == &Font16) return &FONT16_ATLAS;\n"
+        "    if (font == &Font20) return &FONT20_ATLAS;\n"
+        "    if (font == &Font24) return &FONT24_ATLAS;\n"
+        "    return nullptr;\n"
+        "}\n");
+
+    // Replace output only when complete
+    if (fclose(out) != 0 || rename(temp.c_str(), path.c_str()) != 0) {
+        perror(path.c_str());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,125 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Import games from PGN files into the games database, e.g., to load a club's
+// archive onto the board for review.
+//
+// usage: pgn_import [-d database] [-b batch] [file.pgn ...]
+//
+//   -d database  database to import into (default is the board's database)
+//   -b batch     games per transaction (default 1000)
+//   file.pgn     files to import, or standard input if none or "-"
+
+#include "db.h"
+#include "utility/mapped_file.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+using namespace std;
+
+// Offset of last tag section, i.e., tags following a blank line, or zero
+static size_t last_game(string_view text) {
+    auto end = text.rfind("\n[");
+    for (; end != string_view::npos && end > 0; end = text.rfind("\n[", end - 1)) {
+        const auto line = text.find_last_not_of(" \t\r", end - 1);
+        if (line == string_view::npos || text[line] == '\n') {
+            return end + 1;
+        }
+    }
+    return 0;
+}
+
+// Read stream in chunks, importing the complete games in each.  A game is
+// complete once the next game's tags have begun.
+static int import_stream(Database& database, FILE* in, ImportStats& stats, long batch) {
+    string buffer;
+    char   chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof chunk, in)) > 0) {
+        buffer.append(chunk, n);
+        const auto end = last_game(buffer);
+        if (end == 0) {
+            continue;
+        }
+        if (database.import_pgn(string_view{buffer}.substr(0, end), stats, batch)) {
+            return 1;
+        }
+        buffer.erase(0, end);
+    }
+    return database.import_pgn(buffer, stats, batch);
+}
+
+static int import_file(Database& database, const char* path, ImportStats& stats, long batch) {
+    if (strcmp(path, "-") == 0) {
+        return import_stream(database, stdin, stats, batch);
+    }
+    const MappedFile file{path};
+    return database.import_pgn(file.view(), stats, batch);
+}
+
+int main(int argc, char* argv[]) {
+    const char* path  = nullptr;
+    long        batch = 1000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:b:")) != -1) {
+        switch (opt) {
+        case 'd':
+            path = optarg;
+            break;
+        case 'b':
+            batch = atol(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d database] [-b batch] [file.pgn ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (batch < 1) {
+        batch = 1;
+    }
+
+    ImportStats stats;
+    auto rc = 0;
+    try {
+        // Board's database unless another is given
+        const auto database = path ? make_unique<Database>(path) : make_unique<Database>();
+        if (optind >= argc) {
+            rc = import_file(*database, "-", stats, batch);
+        }
+        for (auto i = optind; i < argc && rc == 0; ++i) {
+            rc = import_file(*database, argv[i], stats, batch);
+        }
+    }
+    catch (const runtime_error& e) {
+        fprintf(stderr, "%s\n", e.what());
+        rc = 1;
+    }
+
+    printf("%ld games imported, %ld skipped, in %.2f s (%.0f games/s)\n",
+        stats.games, stats.skipped, stats.seconds,
+        stats.seconds > 0 ? stats.games / stats.seconds : 0.0);
+    return rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -2,18 +2,45 @@
 // See license at end of file
 
 #include "screen.h"
+#include "cfg.h"
 
+#include <cassert>
 #include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <stdexcept>
+#include <vector>
 
 #include <alloca.h>
 
 using namespace std;
 
+// Renders following each other within COALESCE_WINDOW, e.g., board and move
+// list after a move, are shown in a single update, but none is held back for
+// longer than COALESCE_LIMIT.
+static const auto COALESCE_WINDOW = chrono::milliseconds(20);
+static const auto COALESCE_LIMIT  = chrono::milliseconds(100);
+
+// Each partial update leaves a little ghosting behind.  After this many pixels
+// have changed, about a quarter of the screen, or a few dozen moves, the next
+// update refreshes the whole display instead.
+static const long GHOST_LIMIT = SCREEN_WIDTH * SCREEN_HEIGHT / 4;
+
+static long changed_pixels(const uint8_t* before, const uint8_t* after, size_t size) {
+    long n = 0;
+    for (size_t i = 0; i < size; ++i) {
+        n += __builtin_popcount(before[i] ^ after[i]);
+    }
+    return n;
+}
+
 // E-Paper updates can be slow, and we don't want to block, so we offload
 // them to a separate thread.
+//
+// Whatever is rendered while an update is in progress is picked up by the
+// next one, so a busy display falls behind by at most a single update.  The
+// display is put to sleep after cfg_screen_sleep() seconds without changes,
+// and fully refreshed on waking, because its memory doesn't survive sleep.
 void Screen::update_epd2in9d() {
     // Debug out-of-control threads
     static bool once_only = false;
@@ -22,83 +49,178 @@ void Screen::update_epd2in9d() {
     }
     once_only = true;
 
-    epd2in9d.wake();
-
     const auto width_bytes = (SCREEN_WIDTH + 7) / 8;
     const auto size_bytes  = width_bytes * SCREEN_HEIGHT;
+    const auto idle        = chrono::seconds(cfg_screen_sleep());
 
-    const auto new_image = (uint8_t*)alloca(size_bytes);
-    const auto old_image = (uint8_t*)alloca(size_bytes);
-    memset(old_image, -1, size_bytes);
-    memset(new_image, -1, size_bytes);
+    // What the display is showing
+    const auto image_data = (uint8_t*)alloca(size_bytes);
+    memset(image_data, PIXEL_WHITE, size_bytes);
 
-    {
-        lock_guard<std::mutex> lock(mutex);
-        memcpy(new_image, image[0]->data(), size_bytes);
-    }
-    memcpy(old_image, new_image, size_bytes);
-    epd2in9d.display(old_image);
+    auto asleep   = true;
+    auto ghosting = 0L;  // Pixels changed since last full refresh
 
-    struct timespec last_render;
-    clock_gettime(CLOCK_REALTIME, &last_render);
+    auto pending = [this]() { return shutdown || !dirty.empty(); };
 
     while (!shutdown) {
-        auto timeout = chrono::system_clock::now() + chrono::seconds(100);
+        Rect band;
+        long changed;
         {
             unique_lock<std::mutex> lock(mutex);
-            cond.wait_until(lock, timeout);
+            if (asleep || idle.count() == 0) {
+                cond.wait(lock, pending);
+            } else if (!cond.wait_for(lock, idle, pending)) {
+                lock.unlock();
+                epd2in9d.sleep();
+                asleep = true;
+                continue;
+            }
+
+            const auto deadline = chrono::steady_clock::now() + COALESCE_LIMIT;
+            for (auto generation = generation_; !shutdown; generation = generation_) {
+                const auto more = cond.wait_for(lock, COALESCE_WINDOW, [&]() {
+                    return shutdown || generation_ != generation;
+                });
+                if (!more || chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+            }
             if (shutdown) {
                 break;
             }
-            memcpy(new_image, image[0]->data(), size_bytes);
-        }
 
-        const bool dirty = memcmp(new_image, old_image, size_bytes) != 0;
-        if (!dirty) {
-            continue;
+            band  = dirty;
+            dirty = {0, 0, 0, 0};
+            const auto offset = band.top * width_bytes;
+            const auto size   = (band.bottom - band.top) * width_bytes;
+            changed = changed_pixels(image_data + offset, image->data() + offset, size);
+            memcpy(image_data + offset, image->data() + offset, size);
         }
 
-        memcpy(old_image, new_image, size_bytes);
-        epd2in9d.update(old_image);
-
-        // Eventually we'll want to sleep if nothing is happening.
-        clock_gettime(CLOCK_REALTIME, &last_render);
+        if (asleep) {
+            epd2in9d.wake();
+            epd2in9d.display(image_data);
+            asleep   = false;
+            ghosting = 0;
+        } else if (changed == 0) {
+            // Changed back before it was ever shown
+        } else if (ghosting + changed >= GHOST_LIMIT) {
+            epd2in9d.display(image_data);
+            ghosting = 0;
+        } else {
+            epd2in9d.update(image_data, band.top, band.bottom);
+            ghosting += changed;
+        }
     }
 }
 
 Screen::~Screen() {
-    shutdown = true;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        shutdown = true;
+    }
     cond.notify_one();
     thread.join();
 }
 
 Screen::Screen()
 {
-    image[0] = make_unique<Image>(SCREEN_WIDTH, SCREEN_HEIGHT);
-    image[1] = make_unique<Image>(SCREEN_WIDTH, SCREEN_HEIGHT);
+    image = make_unique<Image>(SCREEN_WIDTH, SCREEN_HEIGHT);
+    context.image  = image.get();
     context.rotate = ROTATE_180;
+    context.clear();
+    dirty = {0, 0, image->width, image->height};
     thread = std::thread(&Screen::update_epd2in9d, this);
 }
 
+// Only the areas the view reports as invalid are erased and redrawn, and only
+// the band of rows they span is compared against what was there before.
 void Screen::render(View& view) {
+    vector<Rect> rects;
+    bool changed_band = false;
     {
         lock_guard<std::mutex> lock(mutex);
 
-        swap(image[0], image[1]);
-        context.image = image[0].get();
-        context.clear();
-        view.render(context);
+        view.invalidated(context, rects);
+        Rect band{0, 0, 0, 0};
+        for (const auto& rect : rects) {
+            const auto device = context.transform_rect(rect);
+            band = band.united({
+                max(device.left, 0), max(device.top, 0),
+                min(device.right, image->width), min(device.bottom, image->height),
+            });
+        }
+        if (band.empty()) {
+            return;
+        }
+        band.left  = 0;
+        band.right = image->width;
+
+        const auto offset = band.top * image->width_bytes;
+        const auto size   = (band.bottom - band.top) * image->width_bytes;
+        const auto before = (uint8_t*)alloca(size);
+        memcpy(before, image->data() + offset, size);
+
+        const auto clip = context.clip;
+        for (const auto& rect : rects) {
+            context.clip = rect;
+            context.eraserect(rect.left, rect.top, rect.right - 1, rect.bottom - 1);
+            view.render(context);
+        }
+        context.clip = clip;
+
+        changed_band = memcmp(before, image->data() + offset, size) != 0;
+        if (changed_band) {
+            ++generation_;
+            dirty = dirty.united(band);
+        }
     }
 
-    if (*image[0] != *image[1]) {
+    if (changed_band) {
         cond.notify_all();
         changed();
     }
 }
 
-int Screen::png(uint8_t** png, size_t* size) const {
+uint64_t Screen::generation() const {
     lock_guard<std::mutex> lock(mutex);
-    return image[0]->png(png, size);
+    return generation_;
+}
+
+// Encoding happens outside the display lock, so rendering isn't held up, but
+// under the frame lock, so concurrent requests for a new generation wait for
+// the first one to finish encoding rather than each encoding it themselves.
+shared_ptr<const ScreenFrame> Screen::frame(ScreenFormat format) const {
+    assert(format >= 0 && format < NUM_SCREEN_FORMATS);
+    lock_guard<std::mutex> frame_lock(frame_mutex);
+
+    auto frame = make_shared<ScreenFrame>();
+    Image snapshot{SCREEN_WIDTH, SCREEN_HEIGHT};
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if (frames[format] && frames[format]->generation == generation_) {
+            return frames[format];
+        }
+        frame->generation = generation_;
+        snapshot.data_ = image->data_;
+    }
+
+    switch (format) {
+    case SCREEN_PNG:
+        frame->data.resize(snapshot.png_bound());
+        frame->data.resize(snapshot.png(frame->data.data(), frame->data.size()));
+        break;
+
+    case SCREEN_RAW:
+        frame->data = move(snapshot.data_);
+        break;
+
+    default:
+        return nullptr;
+    }
+
+    frames[format] = frame;
+    return frame;
 }
 
 // This file is part of the Raccoon's Centaur Mods (RCM).
@@ -11,14 +11,28 @@
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
+
+enum ScreenFormat {
+    SCREEN_PNG,
+    SCREEN_RAW,  // 1 bpp, rows padded to whole bytes, MSB first, 1 is white
+    NUM_SCREEN_FORMATS,
+};
+
+// Encoded image of display, shared by everyone asking for the same generation
+struct ScreenFrame {
+    std::uint64_t generation;
+    std::vector<std::uint8_t> data;
+};
 
 class Screen : public Model<Screen> {
 public:
     Epd2in9d    epd2in9d;
     Context     context;
-    std::unique_ptr<Image>  image[2];
+    std::unique_ptr<Image>  image;
     std::condition_variable cond;
     mutable std::mutex  mutex;
     std::thread thread;
@@ -30,13 +44,25 @@ public:
     // Initialize display
     Screen();
 
-    // Render UI to display
+    // Redraw those parts of the UI that have changed, and update them on the
+    // display
     void render(View& view);
 
-    // Get PNG image of display
-    int png(std::uint8_t** png, std::size_t* size) const;
+    // Incremented whenever display image changes
+    std::uint64_t generation() const;
+
+    // Get encoded image of display.  Each generation is encoded at most once
+    // per format, however many clients ask for it.
+    std::shared_ptr<const ScreenFrame> frame(ScreenFormat format) const;
 
 private:
+    std::uint64_t generation_{0};
+    Rect          dirty{0, 0, 0, 0};  // Changed since last display update
+
+
+    mutable std::mutex frame_mutex;
+    mutable std::shared_ptr<const ScreenFrame> frames[NUM_SCREEN_FORMATS];
+
     void update_epd2in9d();
 };
 
@@ -32,8 +32,8 @@ void Epd2in9d::display(const uint8_t* data) {
     printf("epd2in9d_display(%p)\n", (void*)data);
 }
 
-void Epd2in9d::update(const uint8_t* data) {
-    printf("epd2in9d_update(%p)\n", (void*)data);
+void Epd2in9d::update(const uint8_t* data, int top, int bottom) {
+    printf("epd2in9d_update(%p, %d, %d)\n", (void*)data, top, bottom);
     sleep_ms(100);
 }
 
@@ -32,8 +32,9 @@ public:
     void display(const std::uint8_t* data);
 
     // Partially update display.  That is, instruct the e-Paper to make the
-    // minimal changes necessary to display the new image.
-    void update(const std::uint8_t* data);
+    // minimal changes necessary to display the new image.  Only rows from top
+    // up to bottom are sent to the display and refreshed.
+    void update(const std::uint8_t* data, int top = 0, int bottom = SCREEN_HEIGHT);
 };
 
 #endif
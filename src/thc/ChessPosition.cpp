@@ -32,8 +32,10 @@
 #include "ChessPosition.h"
 #include "fen.h"
 #include "gen.h"
+#include "movegen.h"
 #include "san.h"
 #include "uci.h"
+#include "zobrist.h"
 
 #include <cctype>
 #include <cstdio>
@@ -46,10 +48,17 @@ using namespace thc;
 
 
 bool operator==(const ChessPosition& lhs, const ChessPosition& rhs) {
-    return lhs.white == rhs.white &&
+    // Differing hashes imply differing positions, so check that first.  The
+    // hash also covers castling and en passant as they actually apply.  Raw
+    // flags are not cleared when a king or rook moves away, so a position
+    // played from the start and the same position read from FEN may differ in
+    // flags alone.
+    return lhs.key == rhs.key &&
+        lhs.white == rhs.white &&
         lhs.half_move_clock == rhs.half_move_clock &&
         lhs.full_move_count == rhs.full_move_count &&
-        lhs.d == rhs.d &&
+        lhs.d.wking_square == rhs.d.wking_square &&
+        lhs.d.bking_square == rhs.d.bking_square &&
         memcmp(lhs.squares, rhs.squares, sizeof lhs.squares) == 0;
 }
 
@@ -65,6 +74,30 @@ ChessPosition::ChessPosition()
         "        "
         "PPPPPPPP"
         "RNBQKBNR", sizeof squares);
+    rebuild();
+}
+
+
+void ChessPosition::rebuild() {
+    key = zobrist::hash(*this);
+
+    white_pieces = 0;
+    black_pieces = 0;
+    for (auto sq = a8; sq <= h1; ++sq) {
+        if (IsWhite(squares[sq])) {
+            white_pieces |= uint64_t{1} << sq;
+        }
+        else if (IsBlack(squares[sq])) {
+            black_pieces |= uint64_t{1} << sq;
+        }
+    }
+}
+
+
+void ChessPosition::Toggle() {
+    key ^= zobrist::state(*this);
+    white = !white;
+    key ^= zobrist::state(*this);
 }
 
 
@@ -141,7 +174,27 @@ string ChessPosition::move_uci(const Move& move) const {
 }
 
 
+void ChessPosition::put(Square square, char piece) {
+    key ^= zobrist::piece(squares[square], square) ^ zobrist::piece(piece, square);
+    squares[square] = piece;
+
+    const auto mask = uint64_t{1} << square;
+    white_pieces &= ~mask;
+    black_pieces &= ~mask;
+    if (IsWhite(piece)) {
+        white_pieces |= mask;
+    }
+    else if (IsBlack(piece)) {
+        black_pieces |= mask;
+    }
+}
+
+
 void ChessPosition::apply_move(const Move& move) {
+    // Remove castling, en passant and side to move from hash, they're restored
+    // at the end once we know their new values
+    key ^= zobrist::state(*this);
+
     // Update full move count
     if (BlackToPlay()) {
         ++full_move_count;
@@ -191,14 +244,14 @@ void ChessPosition::apply_move(const Move& move) {
     // Special handling might be required
     switch (move.special) {
     default:
-        squares[move.dst] = squares[move.src];
-        squares[move.src] = ' ';
+        put(move.dst, squares[move.src]);
+        put(move.src, ' ');
         break;
 
     // King move updates king position in details field
     case SPECIAL_KING_MOVE:
-        squares[move.dst] = squares[move.src];
-        squares[move.src] = ' ';
+        put(move.dst, squares[move.src]);
+        put(move.src, ' ');
         if (white) {
             d.wking_square = move.dst;
         }
@@ -209,83 +262,85 @@ void ChessPosition::apply_move(const Move& move) {
 
     // In promotion case, dst piece doesn't equal src piece
     case SPECIAL_PROMOTION_QUEEN:
-        squares[move.src] = ' ';
-        squares[move.dst] = white ? 'Q' : 'q';
+        put(move.src, ' ');
+        put(move.dst, white ? 'Q' : 'q');
         break;
     case SPECIAL_PROMOTION_ROOK:
-        squares[move.src] = ' ';
-        squares[move.dst] = white ? 'R' : 'r';
+        put(move.src, ' ');
+        put(move.dst, white ? 'R' : 'r');
         break;
     case SPECIAL_PROMOTION_BISHOP:
-        squares[move.src] = ' ';
-        squares[move.dst] = white ? 'B' : 'b';
+        put(move.src, ' ');
+        put(move.dst, white ? 'B' : 'b');
         break;
     case SPECIAL_PROMOTION_KNIGHT:
-        squares[move.src] = ' ';
-        squares[move.dst] = white ? 'N' : 'n';
+        put(move.src, ' ');
+        put(move.dst, white ? 'N' : 'n');
         break;
 
     // White enpassant removes (black) pawn south of destination
     case SPECIAL_WEN_PASSANT:
-        squares[move.src] = ' ';
-        squares[move.dst] = 'P';
-        squares[SOUTH(move.dst)] = ' ';
+        put(move.src, ' ');
+        put(move.dst, 'P');
+        put(SOUTH(move.dst), ' ');
         break;
 
     // Black enpassant removes (white) pawn north of destination
     case SPECIAL_BEN_PASSANT:
-        squares[move.src] = ' ';
-        squares[move.dst] = 'p';
-        squares[NORTH(move.dst)] = ' ';
+        put(move.src, ' ');
+        put(move.dst, 'p');
+        put(NORTH(move.dst), ' ');
         break;
 
     // White pawn advances 2 squares sets an enpassant target
     case SPECIAL_WPAWN_2SQUARES:
-        squares[move.src] = ' ';
-        squares[move.dst] = 'P';
+        put(move.src, ' ');
+        put(move.dst, 'P');
         d.enpassant_target = SOUTH(move.dst);
         break;
 
     // Black pawn advances 2 squares sets an enpassant target
     case SPECIAL_BPAWN_2SQUARES:
-        squares[move.src] = ' ';
-        squares[move.dst] = 'p';
+        put(move.src, ' ');
+        put(move.dst, 'p');
         d.enpassant_target = NORTH(move.dst);
         break;
 
     // Castling moves update 4 squares each
     case SPECIAL_WK_CASTLING:
-        squares[e1] = ' ';
-        squares[f1] = 'R';
-        squares[g1] = 'K';
-        squares[h1] = ' ';
+        put(e1, ' ');
+        put(f1, 'R');
+        put(g1, 'K');
+        put(h1, ' ');
         d.wking_square = g1;
         break;
     case SPECIAL_WQ_CASTLING:
-        squares[e1] = ' ';
-        squares[d1] = 'R';
-        squares[c1] = 'K';
-        squares[a1] = ' ';
+        put(e1, ' ');
+        put(d1, 'R');
+        put(c1, 'K');
+        put(a1, ' ');
         d.wking_square = c1;
         break;
     case SPECIAL_BK_CASTLING:
-        squares[e8] = ' ';
-        squares[f8] = 'r';
-        squares[g8] = 'k';
-        squares[h8] = ' ';
+        put(e8, ' ');
+        put(f8, 'r');
+        put(g8, 'k');
+        put(h8, ' ');
         d.bking_square = g8;
         break;
     case SPECIAL_BQ_CASTLING:
-        squares[e8] = ' ';
-        squares[d8] = 'r';
-        squares[c8] = 'k';
-        squares[a8] = ' ';
+        put(e8, ' ');
+        put(d8, 'r');
+        put(c8, 'k');
+        put(a8, ' ');
         d.bking_square = c8;
         break;
     }
 
     // Toggle who-to-move
     white = !white;
+
+    key ^= zobrist::state(*this);
 }
 
 
@@ -319,5 +374,5 @@ bool ChessPosition::Evaluate(const Move& move) const {
 
 
 vector<Move> ChessPosition::legal_moves() const {
-    return gen::GenLegalMoveList(*this);
+    return movegen::GenLegalMoveList(*this);
 }
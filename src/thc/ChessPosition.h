@@ -11,7 +11,9 @@
 
 #include "Detail.h"
 #include "Move.h"
+#include "zobrist.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -46,18 +48,30 @@ public:
 
     DETAIL d;
 
+    // Zobrist hash of position, maintained incrementally by apply_move
+    zobrist::Key key{0};
+
+    // Occupied squares by colour, bit index is Square (a8=0 etc.), also
+    //  maintained incrementally by apply_move
+    std::uint64_t white_pieces{0};
+    std::uint64_t black_pieces{0};
+
     ChessPosition();
     ChessPosition(const ChessPosition&) = default;
 
+    // Recompute hash and occupancy after editing squares directly
+    void rebuild();
+
     bool Forsyth(const char*);
     std::string fen() const;
 
     // Who's turn is it anyway?
     inline bool WhiteToPlay() const { return  white; }
     inline bool BlackToPlay() const { return !white; }
-    void Toggle() { white = !white; }
+    void Toggle();
 
     char at(Square sq) const { return squares[sq]; }
+    std::uint64_t occupied() const { return white_pieces | black_pieces; }
 
     // Castling allowed?
     bool wking_allowed()  const { return d.wking()  && at(e1)=='K' && at(h1)=='R'; }
@@ -90,6 +104,9 @@ public:
 
 private:
     void apply_move(const Move&);
+
+    // Place piece on square, updating hash and occupancy
+    void put(Square, char);
 };
 
 }
@@ -0,0 +1,598 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+#include "bitgen.h"
+#include "ChessPosition.h"
+#include "gen.h"
+
+#include "PrivateChessDefs.h"
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace thc;
+using namespace thc::bitgen;
+
+namespace {
+
+// Ray directions, in the order the reference generator visits them.  With
+// a8=0, "south" and "east" are toward higher square numbers.
+enum Direction {
+    WEST, EAST, SOUTH, NORTH, SOUTHWEST, NORTHWEST, NORTHEAST, SOUTHEAST,
+    NUM_DIRECTIONS
+};
+
+const int file_step[NUM_DIRECTIONS] = {-1, +1,  0,  0, -1, -1, +1, +1};
+const int row_step[NUM_DIRECTIONS]  = { 0,  0, +1, -1, +1, -1, -1, +1};
+
+const Direction opposite[NUM_DIRECTIONS] = {
+    EAST, WEST, NORTH, SOUTH, NORTHEAST, SOUTHEAST, SOUTHWEST, NORTHWEST
+};
+
+// True if squares along the ray have increasing square numbers
+inline bool ascending(Direction dir) {
+    return dir == EAST || dir == SOUTH || dir == SOUTHWEST || dir == SOUTHEAST;
+}
+
+const Direction rook_directions[]   = {WEST, EAST, SOUTH, NORTH};
+const Direction bishop_directions[] = {SOUTHWEST, NORTHWEST, NORTHEAST, SOUTHEAST};
+const Direction queen_directions[]  = {
+    WEST, EAST, SOUTH, NORTH, SOUTHWEST, NORTHWEST, NORTHEAST, SOUTHEAST
+};
+
+const Bitboard RANK_8 = 0x00000000000000FFull;
+const Bitboard RANK_1 = 0xFF00000000000000ull;
+const Bitboard FILE_A = 0x0101010101010101ull;
+const Bitboard FILE_H = 0x8080808080808080ull;
+
+inline Square lsb(Bitboard b) { return static_cast<Square>(__builtin_ctzll(b)); }
+inline Square msb(Bitboard b) { return static_cast<Square>(63 - __builtin_clzll(b)); }
+inline bool more_than_one(Bitboard b) { return b & (b - 1); }
+
+inline bool on_board(int file, int row) {
+    return 0 <= file && file < 8 && 0 <= row && row < 8;
+}
+
+// Walk rays from square, stopping at (and including) the first occupied square
+Bitboard slide(int sq, const Direction* dirs, int n, Bitboard occupied) {
+    Bitboard result = 0;
+    for (auto i = 0; i != n; ++i) {
+        auto file = sq % 8;
+        auto row  = sq / 8;
+        for (;;) {
+            file += file_step[dirs[i]];
+            row  += row_step[dirs[i]];
+            if (!on_board(file, row)) {
+                break;
+            }
+            const auto b = Bitboard{1} << (8 * row + file);
+            result |= b;
+            if (occupied & b) {
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+// Deterministic, so magics are the same from run to run
+class Random {
+    std::uint64_t s{1070372};
+
+public:
+    std::uint64_t next() {
+        s ^= s >> 12;
+        s ^= s << 25;
+        s ^= s >> 27;
+        return s * 2685821657736338717ull;
+    }
+
+    std::uint64_t sparse() { return next() & next() & next(); }
+};
+
+struct Magic {
+    Bitboard  mask;
+    Bitboard  magic;
+    Bitboard* attacks;
+    unsigned  shift;
+
+    unsigned index(Bitboard occupied) const {
+#if defined(__BMI2__)
+        return unsigned(_pext_u64(occupied, mask));
+#else
+        return unsigned(((occupied & mask) * magic) >> shift);
+#endif
+    }
+};
+
+struct Tables {
+    Bitboard rays[NUM_DIRECTIONS][64];
+    Bitboard knight[64];
+    Bitboard king[64];
+    Bitboard pawn_attacks[2][64];  // Squares attacked by white[0] or black[1] pawn
+    Bitboard between[64][64];      // Squares strictly between two aligned squares
+    Bitboard line[64][64];         // Full line through two aligned squares
+    Magic    bishop[64];
+    Magic    rook[64];
+    std::vector<Bitboard> attacks;
+
+    Tables();
+
+private:
+    void init_magics(Magic* magics, const Direction* dirs, int n, Bitboard* table);
+};
+
+// Find a magic multiplier for each square that maps every relevant occupancy
+// to a slot holding the right attack set.
+void Tables::init_magics(Magic* magics, const Direction* dirs, int n, Bitboard* table) {
+    Bitboard occupancy[4096];
+    Bitboard reference[4096];
+    int      epoch[4096] = {0};
+    int      count = 0;
+    Random   random;
+
+    for (auto sq = 0; sq != 64; ++sq) {
+        const Bitboard edges =
+            ((RANK_1 | RANK_8) & ~(RANK_8 << (8 * (sq / 8)))) |
+            ((FILE_A | FILE_H) & ~(FILE_A << (sq % 8)));
+
+        auto& m = magics[sq];
+        m.mask    = slide(sq, dirs, n, 0) & ~edges;
+        m.shift   = 64 - __builtin_popcountll(m.mask);
+        m.attacks = table;
+
+        // Carry-Rippler enumeration of all subsets of mask
+        auto size = 0;
+        Bitboard b = 0;
+        do {
+            occupancy[size] = b;
+            reference[size] = slide(sq, dirs, n, b);
+            ++size;
+            b = (b - m.mask) & m.mask;
+        } while (b);
+        table += size;
+
+#if defined(__BMI2__)
+        for (auto i = 0; i != size; ++i) {
+            m.attacks[m.index(occupancy[i])] = reference[i];
+        }
+#else
+        for (auto i = 0; i != size; ) {
+            m.magic = 0;
+            while (__builtin_popcountll((m.magic * m.mask) >> 56) < 6) {
+                m.magic = random.sparse();
+            }
+
+            // Slots stamped with an older epoch are free, so we needn't clear
+            // the table between attempts.
+            ++count;
+            for (i = 0; i != size; ++i) {
+                const auto idx = m.index(occupancy[i]);
+                if (epoch[idx] < count) {
+                    epoch[idx] = count;
+                    m.attacks[idx] = reference[i];
+                }
+                else if (m.attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
+#endif
+    }
+}
+
+Tables::Tables() : attacks(102400 + 5248) {
+    for (auto sq = 0; sq != 64; ++sq) {
+        const auto file = sq % 8;
+        const auto row  = sq / 8;
+
+        for (auto dir = 0; dir != NUM_DIRECTIONS; ++dir) {
+            const auto d = static_cast<Direction>(dir);
+            rays[dir][sq] = slide(sq, &d, 1, 0);
+        }
+
+        knight[sq] = 0;
+        const int knight_steps[8][2] = {
+            {-2, -1}, {-2, +1}, {-1, -2}, {-1, +2}, {+1, -2}, {+1, +2}, {+2, -1}, {+2, +1},
+        };
+        for (const auto& step : knight_steps) {
+            if (on_board(file + step[0], row + step[1])) {
+                knight[sq] |= Bitboard{1} << (8 * (row + step[1]) + file + step[0]);
+            }
+        }
+
+        king[sq] = 0;
+        for (auto dir = 0; dir != NUM_DIRECTIONS; ++dir) {
+            if (on_board(file + file_step[dir], row + row_step[dir])) {
+                king[sq] |= Bitboard{1} << (8 * (row + row_step[dir]) + file + file_step[dir]);
+            }
+        }
+
+        pawn_attacks[0][sq] = pawn_attacks[1][sq] = 0;
+        for (auto df : {-1, +1}) {
+            if (on_board(file + df, row - 1)) {
+                pawn_attacks[0][sq] |= Bitboard{1} << (8 * (row - 1) + file + df);
+            }
+            if (on_board(file + df, row + 1)) {
+                pawn_attacks[1][sq] |= Bitboard{1} << (8 * (row + 1) + file + df);
+            }
+        }
+    }
+
+    for (auto a = 0; a != 64; ++a) {
+        for (auto b = 0; b != 64; ++b) {
+            between[a][b] = line[a][b] = 0;
+        }
+        for (auto dir = 0; dir != NUM_DIRECTIONS; ++dir) {
+            Bitboard path = 0;
+            for (auto ray = rays[dir][a]; ray; ) {
+                const auto b = ascending(static_cast<Direction>(dir)) ? lsb(ray) : msb(ray);
+                ray &= ~bit(b);
+                between[a][b] = path;
+                line[a][b]    = rays[dir][a] | rays[opposite[dir]][a] | bit(static_cast<Square>(a));
+                path |= bit(b);
+            }
+        }
+    }
+
+    init_magics(rook, rook_directions, 4, attacks.data());
+    init_magics(bishop, bishop_directions, 4, attacks.data() + 102400);
+}
+
+const Tables& tables() {
+    static const Tables tables;
+    return tables;
+}
+
+const Bitboard BACK_RANKS = RANK_1 | RANK_8;
+
+Bitboard attackers_to(const Tables& t, const Bitboards& b, Square sq, Bitboard occupied) {
+    return
+        (t.pawn_attacks[1][sq] & b.pawns & b.white) |
+        (t.pawn_attacks[0][sq] & b.pawns & b.black) |
+        (t.knight[sq] & b.knights) |
+        (t.king[sq] & b.kings) |
+        (t.rook[sq].attacks[t.rook[sq].index(occupied)] & (b.rooks | b.queens)) |
+        (t.bishop[sq].attacks[t.bishop[sq].index(occupied)] & (b.bishops | b.queens));
+}
+
+// Generate moves in ray order, e.g. for a rook: west, east, south, north, each
+// ray working outward from the piece.
+void SlidingMoves(
+    const ChessPosition& position,
+    const Tables&        t,
+    Square               src,
+    Bitboard             targets,
+    const Direction*     dirs,
+    int                  n,
+    vector<Move>&        moves)
+{
+    for (auto i = 0; i != n; ++i) {
+        auto ray = targets & t.rays[dirs[i]][src];
+        while (ray) {
+            const auto dst = ascending(dirs[i]) ? lsb(ray) : msb(ray);
+            ray &= ~bit(dst);
+            moves.push_back({src, dst, NOT_SPECIAL, position.squares[dst]});
+        }
+    }
+}
+
+void PromotionMoves(Square src, Square dst, char capture, vector<Move>& moves) {
+    moves.push_back({src, dst, SPECIAL_PROMOTION_QUEEN,  capture});
+    moves.push_back({src, dst, SPECIAL_PROMOTION_KNIGHT, capture});
+    moves.push_back({src, dst, SPECIAL_PROMOTION_BISHOP, capture});
+    moves.push_back({src, dst, SPECIAL_PROMOTION_ROOK,   capture});
+}
+
+}
+
+
+Bitboards::Bitboards(const ChessPosition& position) {
+    for (auto sq = a8; sq <= h1; ++sq) {
+        const auto b = bit(sq);
+        switch (position.squares[sq]) {
+        case 'P': white |= b; pawns   |= b; break;
+        case 'N': white |= b; knights |= b; break;
+        case 'B': white |= b; bishops |= b; break;
+        case 'R': white |= b; rooks   |= b; break;
+        case 'Q': white |= b; queens  |= b; break;
+        case 'K': white |= b; kings   |= b; break;
+        case 'p': black |= b; pawns   |= b; break;
+        case 'n': black |= b; knights |= b; break;
+        case 'b': black |= b; bishops |= b; break;
+        case 'r': black |= b; rooks   |= b; break;
+        case 'q': black |= b; queens  |= b; break;
+        case 'k': black |= b; kings   |= b; break;
+        }
+    }
+}
+
+
+Bitboard bitgen::BishopAttacks(Square square, Bitboard occupied) {
+    const auto& m = tables().bishop[square];
+    return m.attacks[m.index(occupied)];
+}
+
+
+Bitboard bitgen::RookAttacks(Square square, Bitboard occupied) {
+    const auto& m = tables().rook[square];
+    return m.attacks[m.index(occupied)];
+}
+
+
+bool bitgen::AttackedSquare(const ChessPosition& position, Square square, bool enemy_is_white) {
+    const Bitboards b{position};
+    const auto enemy = enemy_is_white ? b.white : b.black;
+    return attackers_to(tables(), b, square, b.occupied()) & enemy;
+}
+
+
+bool bitgen::AttackedPiece(const ChessPosition& position, Square square) {
+    const bool enemy_is_white = IsBlack(position.squares[square]);
+    return AttackedSquare(position, square, enemy_is_white);
+}
+
+
+// Legal moves directly, rather than generating pseudo-legal moves and playing
+// each one to see if it leaves the king in check.  Pinned pieces are confined
+// to the line through the king, and when in check only evasions are allowed.
+void bitgen::GenLegalMoveList(const ChessPosition& position, vector<Move>& moves) {
+    moves.clear();
+
+    const Bitboards b{position};
+    const auto& t = tables();
+
+    const auto white    = position.white;
+    const auto own      = white ? b.white : b.black;
+    const auto enemy    = white ? b.black : b.white;
+    const auto occupied = b.occupied();
+
+    // Positions that can't arise in play (no king, several kings, pawns on
+    // the back rank) are left to the reference generator.
+    if (__builtin_popcountll(b.kings & own) != 1 || (b.pawns & BACK_RANKS)) {
+        moves = gen::GenLegalMoveList(position);
+        return;
+    }
+
+    const auto ksq      = lsb(b.kings & own);
+    const auto checkers = attackers_to(t, b, ksq, occupied) & enemy;
+
+    // Pieces pinned to own king by an enemy slider
+    Bitboard pinned  = 0;
+    Bitboard snipers = enemy & (
+        (t.rook[ksq].attacks[t.rook[ksq].index(0)] & (b.rooks | b.queens)) |
+        (t.bishop[ksq].attacks[t.bishop[ksq].index(0)] & (b.bishops | b.queens)));
+    for (; snipers; snipers &= snipers - 1) {
+        const auto blockers = t.between[ksq][lsb(snipers)] & occupied;
+        if (blockers && !more_than_one(blockers)) {
+            pinned |= blockers & own;
+        }
+    }
+
+    // Squares other than the king may move to
+    Bitboard evasions = ~own;
+    if (checkers) {
+        evasions = more_than_one(checkers) ? 0 : checkers | t.between[ksq][lsb(checkers)];
+    }
+
+    // Would king be safe on square?  (Lifting the king first, so it can't hide
+    // behind itself from a slider.)
+    const auto safe = [&](Square sq) {
+        return !(attackers_to(t, b, sq, occupied ^ bit(ksq)) & enemy);
+    };
+
+    // En passant exposes the king along both the pawn's and the captured pawn's
+    // lines, so just play it out.
+    const auto safe_enpassant = [&](Square src, Square dst, Square captured) {
+        const auto after = (occupied ^ bit(src) ^ bit(captured)) | bit(dst);
+        const auto attackers =
+            (t.rook[ksq].attacks[t.rook[ksq].index(after)] & (b.rooks | b.queens)) |
+            (t.bishop[ksq].attacks[t.bishop[ksq].index(after)] & (b.bishops | b.queens)) |
+            (t.knight[ksq] & b.knights) |
+            (t.pawn_attacks[white ? 0 : 1][ksq] & b.pawns) |
+            (t.king[ksq] & b.kings);
+        return !(attackers & enemy & ~bit(captured));
+    };
+
+    moves.reserve(64);
+
+    for (auto pieces = own; pieces; pieces &= pieces - 1) {
+        const auto src = lsb(pieces);
+
+        auto allowed = evasions;
+        if (pinned & bit(src)) {
+            allowed &= t.line[ksq][src];
+        }
+
+        switch (position.squares[src]) {
+        case 'P': {
+            const auto promotion = RANK(src) == '7';
+
+            // Capture ray
+            const auto* ptr = pawn_white_lookup[src];
+            for (auto nbr_moves = *ptr++; nbr_moves != 0; --nbr_moves) {
+                const auto dst = static_cast<Square>(*ptr++);
+                if (dst == position.d.enpassant_target) {
+                    if (safe_enpassant(src, dst, SOUTH(dst))) {
+                        moves.push_back({src, dst, SPECIAL_WEN_PASSANT, 'p'});
+                    }
+                }
+                else if (bit(dst) & b.black & allowed) {
+                    const auto capture = position.squares[dst];
+                    if (!promotion) {
+                        moves.push_back({src, dst, NOT_SPECIAL, capture});
+                    }
+                    else {
+                        PromotionMoves(src, dst, capture, moves);
+                    }
+                }
+            }
+
+            // Advance ray
+            const auto dst = NORTH(src);
+            if (occupied & bit(dst)) {
+                break;
+            }
+            if (allowed & bit(dst)) {
+                if (!promotion) {
+                    moves.push_back({src, dst, NOT_SPECIAL, ' '});
+                }
+                else {
+                    PromotionMoves(src, dst, ' ', moves);
+                }
+            }
+            const auto dst2 = NORTH(dst);
+            if (RANK(src) == '2' && !(occupied & bit(dst2)) && (allowed & bit(dst2))) {
+                moves.push_back({src, dst2, SPECIAL_WPAWN_2SQUARES, ' '});
+            }
+            break;
+        }
+
+        case 'p': {
+            const auto promotion = RANK(src) == '2';
+
+            // Capture ray
+            const auto* ptr = pawn_black_lookup[src];
+            for (auto nbr_moves = *ptr++; nbr_moves != 0; --nbr_moves) {
+                const auto dst = static_cast<Square>(*ptr++);
+                if (dst == position.d.enpassant_target) {
+                    if (safe_enpassant(src, dst, NORTH(dst))) {
+                        moves.push_back({src, dst, SPECIAL_BEN_PASSANT, 'P'});
+                    }
+                }
+                else if (bit(dst) & b.white & allowed) {
+                    const auto capture = position.squares[dst];
+                    if (!promotion) {
+                        moves.push_back({src, dst, NOT_SPECIAL, capture});
+                    }
+                    else {
+                        PromotionMoves(src, dst, capture, moves);
+                    }
+                }
+            }
+
+            // Advance ray
+            const auto dst = SOUTH(src);
+            if (occupied & bit(dst)) {
+                break;
+            }
+            if (allowed & bit(dst)) {
+                if (!promotion) {
+                    moves.push_back({src, dst, NOT_SPECIAL, ' '});
+                }
+                else {
+                    PromotionMoves(src, dst, ' ', moves);
+                }
+            }
+            const auto dst2 = SOUTH(dst);
+            if (RANK(src) == '7' && !(occupied & bit(dst2)) && (allowed & bit(dst2))) {
+                moves.push_back({src, dst2, SPECIAL_BPAWN_2SQUARES, ' '});
+            }
+            break;
+        }
+
+        case 'N': case 'n': {
+            if (pinned & bit(src)) {
+                break;  // A pinned knight can never move
+            }
+            const auto* ptr = knight_lookup[src];
+            for (auto nbr_moves = *ptr++; nbr_moves != 0; --nbr_moves) {
+                const auto dst = static_cast<Square>(*ptr++);
+                if (allowed & bit(dst)) {
+                    moves.push_back({src, dst, NOT_SPECIAL, position.squares[dst]});
+                }
+            }
+            break;
+        }
+
+        case 'B': case 'b': {
+            const auto targets = t.bishop[src].attacks[t.bishop[src].index(occupied)] & allowed;
+            SlidingMoves(position, t, src, targets, bishop_directions, 4, moves);
+            break;
+        }
+
+        case 'R': case 'r': {
+            const auto targets = t.rook[src].attacks[t.rook[src].index(occupied)] & allowed;
+            SlidingMoves(position, t, src, targets, rook_directions, 4, moves);
+            break;
+        }
+
+        case 'Q': case 'q': {
+            const auto targets = allowed & (
+                t.rook[src].attacks[t.rook[src].index(occupied)] |
+                t.bishop[src].attacks[t.bishop[src].index(occupied)]);
+            SlidingMoves(position, t, src, targets, queen_directions, 8, moves);
+            break;
+        }
+
+        case 'K': case 'k': {
+            const auto* ptr = king_lookup[src];
+            for (auto nbr_moves = *ptr++; nbr_moves != 0; --nbr_moves) {
+                const auto dst = static_cast<Square>(*ptr++);
+                if (!(own & bit(dst)) && safe(dst)) {
+                    moves.push_back({src, dst, SPECIAL_KING_MOVE, position.squares[dst]});
+                }
+            }
+
+            // Castling, under exactly the same conditions as `gen::KingMoves`
+            const auto attacked = [&](Square sq, Bitboard by) {
+                return attackers_to(t, b, sq, occupied) & by;
+            };
+            const auto& squares = position.squares;
+            if (src == e1) {
+                if (squares[g1] == ' ' && squares[f1] == ' ' && squares[h1] == 'R' &&
+                    position.d.wking() &&
+                    !attacked(e1, b.black) && !attacked(f1, b.black) && !attacked(g1, b.black))
+                {
+                    moves.push_back({e1, g1, SPECIAL_WK_CASTLING, ' '});
+                }
+                if (squares[b1] == ' ' && squares[c1] == ' ' && squares[d1] == ' ' &&
+                    squares[a1] == 'R' && position.d.wqueen() &&
+                    !attacked(e1, b.black) && !attacked(d1, b.black) && !attacked(c1, b.black))
+                {
+                    moves.push_back({e1, c1, SPECIAL_WQ_CASTLING, ' '});
+                }
+            }
+            if (src == e8) {
+                if (squares[g8] == ' ' && squares[f8] == ' ' && squares[h8] == 'r' &&
+                    position.d.bking() &&
+                    !attacked(e8, b.white) && !attacked(f8, b.white) && !attacked(g8, b.white))
+                {
+                    moves.push_back({e8, g8, SPECIAL_BK_CASTLING, ' '});
+                }
+                if (squares[b8] == ' ' && squares[c8] == ' ' && squares[d8] == ' ' &&
+                    squares[a8] == 'r' && position.d.bqueen() &&
+                    !attacked(e8, b.white) && !attacked(d8, b.white) && !attacked(c8, b.white))
+                {
+                    moves.push_back({e8, c8, SPECIAL_BQ_CASTLING, ' '});
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+
+vector<Move> bitgen::GenLegalMoveList(const ChessPosition& position) {
+    vector<Move> moves;
+    GenLegalMoveList(position, moves);
+    return moves;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,76 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+#pragma once
+
+// Bitboard move generator.  An alternative to `gen` that keeps one bitmap per
+// piece type and colour and computes sliding attacks with magic (or, where the
+// CPU supports it, PEXT) lookups.  Moves are produced in exactly the same order
+// as `gen::GenLegalMoveList`, so the two are interchangeable; `gen` remains the
+// reference implementation.
+
+#ifndef BITGEN_H
+#define BITGEN_H
+
+#include "ChessDefs.h"
+#include "Move.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace thc {
+
+class ChessPosition;
+
+
+namespace bitgen {
+
+// Set bit indicates presence of piece, bit index is Square (a8=0 ... h1=63)
+using Bitboard = std::uint64_t;
+
+inline Bitboard bit(Square sq) { return Bitboard{1} << sq; }
+
+struct Bitboards {
+    Bitboard white{0};
+    Bitboard black{0};
+    Bitboard pawns{0};
+    Bitboard knights{0};
+    Bitboard bishops{0};
+    Bitboard rooks{0};
+    Bitboard queens{0};
+    Bitboard kings{0};
+
+    explicit Bitboards(const ChessPosition&);
+
+    Bitboard occupied() const { return white | black; }
+};
+
+// Sliding attacks from square given board occupancy
+Bitboard BishopAttacks(Square square, Bitboard occupied);
+Bitboard RookAttacks(Square square, Bitboard occupied);
+
+std::vector<Move> GenLegalMoveList(const ChessPosition& position);
+void GenLegalMoveList(const ChessPosition& position, std::vector<Move>& moves);
+
+bool AttackedPiece(const ChessPosition& position, Square square);
+bool AttackedSquare(const ChessPosition& position, Square square, bool enemy_is_white);
+
+}
+
+}
+
+#endif
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
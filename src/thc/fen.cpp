@@ -350,5 +350,6 @@ ChessPosition fen::to_position(const char* txt) {
             result.full_move_count = temp;
     }
 
+    result.rebuild();
     return result;
 }
@@ -9,6 +9,8 @@
 
 #include "PrivateChessDefs.h"
 
+#include <algorithm>
+
 using namespace std;
 using namespace thc;
 
@@ -277,6 +279,12 @@ void gen::KingMoves(const ChessPosition& position, Square square, vector<Move>&
 
 vector<Move> gen::GenMoveList(const ChessPosition& position) {
     vector<Move> moves;
+    GenMoveList(position, moves);
+    return moves;
+}
+
+void gen::GenMoveList(const ChessPosition& position, vector<Move>& moves) {
+    moves.clear();
 
     for (auto square = a8; square <= h1; ++square) {
         // If square occupied by a piece of the right colour
@@ -310,8 +318,6 @@ vector<Move> gen::GenMoveList(const ChessPosition& position) {
             break;
         }
     }
-
-    return moves;
 }
 
 // Determine if an occupied square is attacked
@@ -322,14 +328,24 @@ bool gen::AttackedPiece(const ChessPosition& position, Square square) {
 
 vector<Move> gen::GenLegalMoveList(const ChessPosition& position) {
     vector<Move> result;
-    for (auto move : GenMoveList(position)) {
-        if (position.Evaluate(move)) {
-            result.push_back(move);
-        }
-    }
+    GenLegalMoveList(position, result);
     return result;
 }
 
+void gen::GenLegalMoveList(const ChessPosition& position, vector<Move>& moves) {
+    GenMoveList(position, moves);
+    moves.erase(
+        remove_if(
+            moves.begin(),
+            moves.end(),
+            [&position](const Move& move) {
+                return !position.Evaluate(move);
+            }
+        ),
+        moves.end()
+    );
+}
+
 bool gen::Evaluate(const ChessPosition& position, TERMINAL& score_terminal) {
     score_terminal = NOT_TERMINAL;
 
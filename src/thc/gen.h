@@ -23,6 +23,10 @@ namespace gen {
 std::vector<Move> GenLegalMoveList(const ChessPosition& position);
 std::vector<Move> GenMoveList(const ChessPosition& position);
 
+// As above, but reuse caller's storage
+void GenLegalMoveList(const ChessPosition& position, std::vector<Move>& moves);
+void GenMoveList(const ChessPosition& position, std::vector<Move>& moves);
+
 void GenLegalMoveList(
     const ChessPosition& position,
     std::vector<Move>& moves,
@@ -0,0 +1,43 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+#pragma once
+
+// Selects the move generator at compile time.  Define THC_BITGEN to use the
+// bitboard generator, otherwise the original mailbox generator is used.  Both
+// provide the same interface and produce moves in the same order.
+
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#ifdef THC_BITGEN
+#include "bitgen.h"
+#else
+#include "gen.h"
+#endif
+
+namespace thc {
+
+#ifdef THC_BITGEN
+namespace movegen = bitgen;
+#else
+namespace movegen = gen;
+#endif
+
+}
+
+#endif
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
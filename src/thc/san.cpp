@@ -6,8 +6,9 @@
 
 #include "san.h"
 #include "ChessPosition.h"
-#include "gen.h"
+#include "movegen.h"
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
 
@@ -32,9 +33,6 @@ string san::from_move(const ChessPosition& position, const Move& move) {
     nmove[1] = '-';
     nmove[2] = '\0';
     vector<Move> list;
-    vector<bool> check;
-    vector<bool> mate;
-    vector<bool> stalemate;
     enum
     {
         ALG_PAWN_MOVE,
@@ -47,16 +45,16 @@ string san::from_move(const ChessPosition& position, const Move& move) {
     bool done=false;
     bool found = false;
     char append='\0';
-    gen::GenLegalMoveList(position, list, check, mate, stalemate);
-    for (int i = 0; i != list.size(); ++i) {
-        Move mfound = list[i];
-        if( mfound == move )
-        {
-            found = true;
-            if( mate[i] )
-                append = '#';
-            else if( check[i] )
-                append = '+';
+    movegen::GenLegalMoveList(position, list);
+    found = find(list.begin(), list.end(), move) != list.end();
+
+    // Check and mate are needed only for this move, not every legal move
+    if (found) {
+        const auto after = position.play_move(move);
+        if (movegen::AttackedPiece(after, after.king_square())) {
+            vector<Move> replies;
+            movegen::GenLegalMoveList(after, replies);
+            append = replies.empty() ? '#' : '+';
         }
     }
 
@@ -220,7 +218,7 @@ Move san::to_move(const ChessPosition& position, string_view san_move) {
     // Copy to read-write variable
     for( i=0; i<sizeof(move); i++ )
     {
-        move[i] = san_move[i];
+        move[i] = i<san_move.size() ? san_move[i] : '\0';
         if( move[i]=='\0' || move[i]==' ' || move[i]=='\t' ||
             move[i]=='\r' || move[i]=='\n' )
         {
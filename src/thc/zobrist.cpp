@@ -0,0 +1,57 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+#include "zobrist.h"
+#include "ChessPosition.h"
+
+using namespace std;
+using namespace thc;
+
+
+zobrist::Key zobrist::state(const ChessPosition& position) {
+    Key key = position.WhiteToPlay() ? 0 : KEYS.black;
+
+    if (position.wking_allowed()) {
+        key ^= KEYS.castling[0];
+    }
+    if (position.wqueen_allowed()) {
+        key ^= KEYS.castling[1];
+    }
+    if (position.bking_allowed()) {
+        key ^= KEYS.castling[2];
+    }
+    if (position.bqueen_allowed()) {
+        key ^= KEYS.castling[3];
+    }
+
+    const auto enpassant = position.groomed_enpassant_target();
+    if (enpassant != SQUARE_INVALID) {
+        key ^= KEYS.enpassant[IFILE(enpassant)];
+    }
+
+    return key;
+}
+
+
+zobrist::Key zobrist::hash(const ChessPosition& position) {
+    auto key = state(position);
+    for (auto sq = a8; sq <= h1; ++sq) {
+        key ^= piece(position.at(sq), sq);
+    }
+    return key;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,109 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+#pragma once
+
+// Zobrist hashing.  Each (piece, square) pair, castling right, en passant file
+// and the side to move is assigned a fixed random key, and a position's hash is
+// the XOR of the keys of all its features.  Because XOR is its own inverse the
+// hash can be updated as moves are played, see `ChessPosition::apply_move`.
+//
+// Only features that matter for repetition are hashed: castling rights count
+// only when king and rook are still in place, and an en passant target only
+// when a pawn is in position to capture.  Move counters are not hashed.
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include "ChessDefs.h"
+
+#include <cstdint>
+
+namespace thc {
+
+class ChessPosition;
+
+
+namespace zobrist {
+
+using Key = std::uint64_t;
+
+struct Keys {
+    Key pieces[12][64];
+    Key castling[4];  // wking, wqueen, bking, bqueen
+    Key enpassant[8];
+    Key black;
+};
+
+// Fixed seed, so hashes are stable between runs (and may be stored)
+constexpr Keys generate_keys() {
+    Keys keys{};
+    std::uint64_t state = 0x9E3779B97F4A7C15;
+    auto next = [&state]() {
+        // SplitMix64
+        auto z = (state += 0x9E3779B97F4A7C15);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    };
+    for (auto& piece : keys.pieces) {
+        for (auto& square : piece) {
+            square = next();
+        }
+    }
+    for (auto& castling : keys.castling) {
+        castling = next();
+    }
+    for (auto& enpassant : keys.enpassant) {
+        enpassant = next();
+    }
+    keys.black = next();
+    return keys;
+}
+
+inline constexpr Keys KEYS = generate_keys();
+
+// Key for piece on square, zero for empty square
+inline Key piece(char piece, Square square) {
+    switch (piece) {
+    case 'P': return KEYS.pieces[ 0][square];
+    case 'N': return KEYS.pieces[ 1][square];
+    case 'B': return KEYS.pieces[ 2][square];
+    case 'R': return KEYS.pieces[ 3][square];
+    case 'Q': return KEYS.pieces[ 4][square];
+    case 'K': return KEYS.pieces[ 5][square];
+    case 'p': return KEYS.pieces[ 6][square];
+    case 'n': return KEYS.pieces[ 7][square];
+    case 'b': return KEYS.pieces[ 8][square];
+    case 'r': return KEYS.pieces[ 9][square];
+    case 'q': return KEYS.pieces[10][square];
+    case 'k': return KEYS.pieces[11][square];
+    default:  return 0;
+    }
+}
+
+// Side to move, castling and en passant contribution
+Key state(const ChessPosition& position);
+
+// Compute hash from scratch
+Key hash(const ChessPosition& position);
+
+}
+
+}
+
+#endif
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -106,6 +106,10 @@ void Buffer::try_fill(long timeout_ms) {
             n_read = 0;
         }
     }
+    else if (n_read == 0 && write < end) {
+        // Readable but nothing read, other end has closed
+        n_read = -1;
+    }
 
     if (n_read >= 0) {
         write += n_read;
@@ -28,6 +28,10 @@ public:
 
     void close();
     char* getline(long timeout_ms);
+
+    // True once closed, including at end of file.  Lines already buffered
+    // may still be read.
+    bool closed() const { return fd < 0; }
 };
 
 #endif
@@ -0,0 +1,125 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+
+// Virtual e-Paper display.  Used for measuring and regression-testing
+// rendering on Linux systems where board is not available.
+//
+// Every call is kept in a ring of recent records.  If SCREEN_RECORD names a
+// file, every frame is also appended to it as a PBM image, which netpbm tools
+// and most image viewers can read, with a comment giving time and rows sent.
+
+#include "epd2in9d.h"
+#include "../cfg.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+#define WIDTH_BYTES  ((SCREEN_WIDTH + 7) / 8)
+#define SCREEN_BYTES (WIDTH_BYTES * SCREEN_HEIGHT)
+
+static const char* KIND_NAMES[] = {"wake", "sleep", "display", "update"};
+
+Epd2in9d::~Epd2in9d() {
+    if (out) {
+        fclose(out);
+    }
+}
+
+Epd2in9d::Epd2in9d()
+    : panel(SCREEN_BYTES, 0xff),
+      opened{chrono::steady_clock::now()}
+{
+    if (const auto path = cfg_screen_record()) {
+        out = fopen(path, "wb");
+        if (!out) {
+            perror(path);
+        }
+    }
+}
+
+void Epd2in9d::sleep() {
+    record(EpdRecord::SLEEP, nullptr, 0, 0);
+}
+
+void Epd2in9d::wake() {
+    record(EpdRecord::WAKE, nullptr, 0, 0);
+}
+
+void Epd2in9d::display(const uint8_t* data) {
+    record(EpdRecord::DISPLAY, data, 0, SCREEN_HEIGHT);
+}
+
+void Epd2in9d::update(const uint8_t* data, int top, int bottom) {
+    if (top < 0) {
+        top = 0;
+    }
+    if (bottom > SCREEN_HEIGHT) {
+        bottom = SCREEN_HEIGHT;
+    }
+    if (bottom <= top) {
+        return;
+    }
+    record(EpdRecord::UPDATE, data, top, bottom);
+}
+
+void Epd2in9d::record(EpdRecord::Kind kind, const uint8_t* data, int top, int bottom) {
+    EpdRecord record{kind, chrono::steady_clock::now(), top, bottom, 0, {}};
+
+    lock_guard<std::mutex> lock(mutex);
+    if (data) {
+        // Only rows sent reach the display
+        const auto begin = top * WIDTH_BYTES;
+        const auto end   = bottom * WIDTH_BYTES;
+        for (auto i = begin; i < end; ++i) {
+            record.changed_bytes += panel[i] != data[i];
+        }
+        memcpy(&panel[begin], data + begin, end - begin);
+        record.image = panel;
+        ++frames;
+
+        if (out) {
+            // PBM is 1 for black, where we're 1 for white
+            const chrono::duration<double> time = record.time - opened;
+            fprintf(out, "P4\n# %.6f %s %d %d\n%d %d\n",
+                time.count(), KIND_NAMES[kind], top, bottom, SCREEN_WIDTH, SCREEN_HEIGHT);
+            for (auto byte : panel) {
+                fputc(~byte & 0xff, out);
+            }
+            fflush(out);
+        }
+    }
+
+    if (ring.size() == CAPACITY) {
+        ring.pop_front();
+    }
+    ring.push_back(move(record));
+    cond.notify_all();
+}
+
+vector<EpdRecord> Epd2in9d::records() const {
+    lock_guard<std::mutex> lock(mutex);
+    return {ring.begin(), ring.end()};
+}
+
+size_t Epd2in9d::wait_frames(size_t seen, chrono::milliseconds timeout) const {
+    unique_lock<std::mutex> lock(mutex);
+    cond.wait_for(lock, timeout, [&]() { return frames > seen; });
+    return frames;
+}
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
@@ -0,0 +1,98 @@
+// Copyright (C) 2024 Eric Sessoms
+// See license at end of file
+#pragma once
+
+// Virtual e-Paper display, recording what would be shown on the DGT Centaur
+// board
+
+#ifndef EPD2IN9D_H
+#define EPD2IN9D_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#define SCREEN_WIDTH  128
+#define SCREEN_HEIGHT 296
+
+// A call to the display, with what it showed afterwards
+struct EpdRecord {
+    enum Kind {
+        WAKE,
+        SLEEP,
+        DISPLAY,  // Full refresh
+        UPDATE,   // Partial update
+    };
+
+    Kind kind;
+    std::chrono::steady_clock::time_point time;
+    int top;            // Rows sent, top up to bottom
+    int bottom;
+    int changed_bytes;  // Bytes of image that differ from previous frame
+    std::vector<std::uint8_t> image;  // Whole display, empty for WAKE, SLEEP
+};
+
+class Epd2in9d {
+public:
+    // Most recent records kept
+    static constexpr std::size_t CAPACITY = 256;
+
+    ~Epd2in9d();
+    Epd2in9d();
+
+    // Put display to sleep
+    void sleep();
+
+    // Initialize display
+    void wake();
+
+    // Fully refresh display.  This is slower and draws more power than partial
+    // updates, but should be done occassionally to cleanup e-Paper artifacts.
+    void display(const std::uint8_t* data);
+
+    // Partially update display.  That is, instruct the e-Paper to make the
+    // minimal changes necessary to display the new image.  Only rows from top
+    // up to bottom are sent to the display and refreshed.
+    void update(const std::uint8_t* data, int top = 0, int bottom = SCREEN_HEIGHT);
+
+    // Copy of most recent records, oldest first
+    std::vector<EpdRecord> records() const;
+
+    // Wait until more than `seen` frames have been shown, i.e., calls to
+    // `display` or `update`, or until timeout.  Return number of frames shown.
+    std::size_t wait_frames(std::size_t seen, std::chrono::milliseconds timeout) const;
+
+private:
+    mutable std::mutex mutex;
+    mutable std::condition_variable cond;
+
+    std::deque<EpdRecord> ring;
+    std::size_t frames{0};
+    std::vector<std::uint8_t> panel;  // What's showing
+    std::chrono::steady_clock::time_point opened;
+    std::FILE* out{nullptr};
+
+    void record(EpdRecord::Kind kind, const std::uint8_t* data, int top, int bottom);
+};
+
+#endif
+
+// This file is part of the Raccoon's Centaur Mods (RCM).
+//
+// RCM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// RCM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
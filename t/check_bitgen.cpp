@@ -0,0 +1,80 @@
+#include "../src/thc/bitgen.h"
+#include "../src/thc/ChessPosition.h"
+#include "../src/thc/gen.h"
+#include "doctest.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace thc;
+
+static string describe(const vector<Move>& moves) {
+    string result;
+    for (const auto& move : moves) {
+        result += move.uci() + " ";
+    }
+    return result;
+}
+
+// Walk game tree comparing bitboard generator against reference generator,
+// returning number of leaf nodes.
+static long walk(const ChessPosition& position, int depth) {
+    const auto expected = gen::GenLegalMoveList(position);
+    const auto actual   = bitgen::GenLegalMoveList(position);
+    if (expected != actual) {
+        INFO(position.fen());
+        CHECK(describe(actual) == describe(expected));
+    }
+
+    if (depth <= 1) {
+        return expected.size();
+    }
+
+    long nodes = 0;
+    for (const auto& move : expected) {
+        nodes += walk(position.play_move(move), depth - 1);
+    }
+    return nodes;
+}
+
+static ChessPosition from_fen(const char* fen) {
+    ChessPosition position;
+    REQUIRE(position.Forsyth(fen));
+    return position;
+}
+
+TEST_CASE("bitgen matches gen: start position") {
+    CHECK(walk(ChessPosition{}, 3) == 8902);
+}
+
+TEST_CASE("bitgen matches gen: Kiwipete") {
+    auto p = from_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    CHECK(walk(p, 2) == 2039);
+}
+
+TEST_CASE("bitgen matches gen: en passant and pins") {
+    auto p = from_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+    CHECK(walk(p, 3) == 2812);
+}
+
+TEST_CASE("bitgen matches gen: promotions") {
+    auto p = from_fen("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+    CHECK(walk(p, 2) == 264);
+
+    p = from_fen("rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8");
+    CHECK(walk(p, 2) == 1486);
+}
+
+TEST_CASE("bitgen matches gen: middlegame") {
+    auto p = from_fen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+    CHECK(walk(p, 2) == 2079);
+}
+
+TEST_CASE("bitgen attacked squares match gen") {
+    auto p = from_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
+    for (auto sq = a8; sq <= h1; ++sq) {
+        CHECK(bitgen::AttackedSquare(p, sq, true)  == gen::AttackedSquare(p, sq, true));
+        CHECK(bitgen::AttackedSquare(p, sq, false) == gen::AttackedSquare(p, sq, false));
+    }
+}
@@ -0,0 +1,173 @@
+#include "../src/db.h"
+#include "doctest.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace std;
+
+// Fresh database in a temporary directory, removed afterwards
+struct TempDatabase {
+    string dir;
+    string path;
+    unique_ptr<Database> database;
+
+    TempDatabase() {
+        char name[] = "/tmp/check_db.XXXXXX";
+        dir  = mkdtemp(name);
+        path = dir + "/rcm.db";
+        database = make_unique<Database>(path.c_str());
+    }
+
+    ~TempDatabase() {
+        database.reset();
+        for (auto suffix : {"", "-wal", "-shm"}) {
+            unlink((path + suffix).c_str());
+        }
+        rmdir(dir.c_str());
+    }
+};
+
+TEST_CASE("save waits for another writer") {
+    TempDatabase temp;
+    auto& database = *temp.database;
+
+    Game game;
+    game.play_san_move("e4");
+    REQUIRE(database.save_game(game) == 0);
+    REQUIRE(game.rowid != 0);
+
+    // Another process, e.g., pgn_import, holds the write lock for a while
+    sqlite3* other = nullptr;
+    REQUIRE(sqlite3_open(temp.path.c_str(), &other) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(other, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr) == SQLITE_OK);
+    thread release([other]() {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        sqlite3_exec(other, "COMMIT", nullptr, nullptr, nullptr);
+    });
+
+    game.play_san_move("e5");
+    database.save_game(game);
+    game.play_san_move("Nf3");
+    database.save_game(game);
+    release.join();
+    sqlite3_close(other);
+
+    const auto loaded = database.load_game(game.rowid);
+    REQUIRE(loaded);
+    CHECK(loaded->fen() == game.fen());
+}
+
+TEST_CASE("new game is saved without waiting for another writer") {
+    TempDatabase temp;
+    auto& database = *temp.database;
+
+    sqlite3* other = nullptr;
+    REQUIRE(sqlite3_open(temp.path.c_str(), &other) == SQLITE_OK);
+    REQUIRE(sqlite3_exec(other, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    Game game;
+    const auto started = chrono::steady_clock::now();
+    for (auto san : {"e4", "e5", "Nf3"}) {
+        game.play_san_move(san);
+        CHECK(database.save_game(game) == 0);
+    }
+    CHECK(chrono::steady_clock::now() - started < chrono::milliseconds(100));
+    CHECK(game.rowid < 0);
+
+    sqlite3_exec(other, "COMMIT", nullptr, nullptr, nullptr);
+    database.flush();
+    CHECK(database.load_game(game.rowid));
+
+    // Next save learns the rowid, and updates the one game inserted
+    game.play_san_move("Nc6");
+    database.save_game(game);
+    CHECK(game.rowid > 0);
+
+    const auto loaded = database.load_game(game.rowid);
+    REQUIRE(loaded);
+    CHECK(loaded->fen() == game.fen());
+
+    sqlite3_stmt* stmt = nullptr;
+    REQUIRE(sqlite3_prepare_v2(other, "SELECT COUNT(*) FROM games", -1, &stmt, nullptr) == SQLITE_OK);
+    REQUIRE(sqlite3_step(stmt) == SQLITE_ROW);
+    CHECK(sqlite3_column_int(stmt, 0) == 1);
+    sqlite3_finalize(stmt);
+    sqlite3_close(other);
+}
+
+TEST_CASE("reload game after editing tags") {
+    TempDatabase temp;
+    auto& database = *temp.database;
+
+    Game game;
+    game.play_san_move("e4");
+    REQUIRE(database.save_game(game) == 0);
+
+    // Players are named after game is first saved
+    game.tag("White") = "Zed";
+    game.play_san_move("e5");
+    database.save_game(game);
+
+    auto loaded = database.load_game(game.rowid);
+    REQUIRE(loaded);
+    CHECK(loaded->tag("White") == "Zed");
+    CHECK(loaded->fen() == game.fen());
+
+    // Result is final, so game is compacted into its PGN
+    game.tag("Black")  = "Amy";
+    game.tag("Result") = "1-0";
+    game.play_san_move("Qh5");
+    database.save_game(game);
+
+    loaded = database.load_game(game.rowid);
+    REQUIRE(loaded);
+    CHECK(loaded->tag("White") == "Zed");
+    CHECK(loaded->tag("Black") == "Amy");
+    CHECK(loaded->pgn().find("[White \"Zed\"]") != string::npos);
+    CHECK(loaded->fen() == game.fen());
+}
+
+TEST_CASE("compaction keeps edits that don't replay") {
+    TempDatabase temp;
+    auto& database = *temp.database;
+
+    Game game;
+    game.play_san_move("e4");
+    REQUIRE(database.save_game(game) == 0);
+    database.flush();
+    game.play_san_move("e5");
+    database.save_game(game);
+    database.flush();
+    const auto fen = game.fen();
+
+    // Log an edit which can't be replayed, a1-a8 is blocked
+    sqlite3* other = nullptr;
+    REQUIRE(sqlite3_open(temp.path.c_str(), &other) == SQLITE_OK);
+    const auto insert = "INSERT INTO edits (game, seq, edit) VALUES((SELECT rowid FROM games), 100, 56)";
+    REQUIRE(sqlite3_exec(other, insert, nullptr, nullptr, nullptr) == SQLITE_OK);
+
+    // Result is final, so game would be compacted into its PGN
+    game.tag("Result") = "1-0";
+    game.play_san_move("Nf3");
+    database.save_game(game);
+    database.flush();
+
+    // Every edit is still logged, none folded into PGN
+    sqlite3_stmt* stmt = nullptr;
+    REQUIRE(sqlite3_prepare_v2(other, "SELECT COUNT(*) FROM edits", -1, &stmt, nullptr) == SQLITE_OK);
+    REQUIRE(sqlite3_step(stmt) == SQLITE_ROW);
+    CHECK(sqlite3_column_int(stmt, 0) == 3);
+    sqlite3_finalize(stmt);
+    sqlite3_close(other);
+
+    // Loads as far as the edit that doesn't replay
+    const auto loaded = database.load_game(game.rowid);
+    REQUIRE(loaded);
+    CHECK(loaded->fen() == fen);
+    CHECK(loaded->tag("Result") == "1-0");
+}
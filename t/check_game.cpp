@@ -73,6 +73,24 @@ TEST_CASE("read 1. e4 from bitmap") {
     CHECK(!takeback.has_value());
 }
 
+TEST_CASE("read 1. e4 again after takeback") {
+    Game g;
+    MoveList candidates;
+    optional<Move> takeback;
+
+    // Playing a move releases the starting position's index, which must be
+    // rebuilt when the starting position is read again.
+    REQUIRE(g.read_move(move(START, e2, e4), ActionHistory{}, candidates, takeback));
+    g.play_move(candidates.at(0));
+    g.play_takeback();
+
+    CHECK(g.read_move(lift(START, g1), ActionHistory{}, candidates, takeback));
+    CHECK(candidates.empty());
+    CHECK(g.read_move(move(START, e2, e4), ActionHistory{}, candidates, takeback));
+    CHECK(candidates.size() == 1);
+    CHECK(g.move_san(candidates.at(0)) == "e4");
+}
+
 TEST_CASE("read 1... e5 from bitmap") {
     Game g;
     g.play_uci_move("e2e4");
@@ -128,3 +146,140 @@ TEST_CASE("read out-of-turn move") {
     optional<Move> takeback;
     CHECK(!g.read_move(lift(START, e7), ActionHistory{}, candidates, takeback));
 }
+
+static Bitmap occupied(const Position& p, bool (*test)(char)) {
+    Bitmap result{0};
+    for (auto sq = a8; sq <= h1; ++sq) {
+        if (test(p.at(sq))) {
+            result = place(result, sq);
+        }
+    }
+    return result;
+}
+
+static Bitmap differences(const Position& a, const Position& b) {
+    Bitmap result{0};
+    for (auto sq = a8; sq <= h1; ++sq) {
+        if (a.at(sq) != b.at(sq)) {
+            result = place(result, sq);
+        }
+    }
+    return result;
+}
+
+TEST_CASE("occupancy follows moves") {
+    // Castling, en passant and promotions all available
+    Position p{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"};
+    for (auto move : p.legal_moves()) {
+        auto after = p.apply_move(move);
+        CHECK(after->white_bitmap() == occupied(*after, IsWhite));
+        CHECK(after->black_bitmap() == occupied(*after, IsBlack));
+        CHECK(p.difference_bitmap(*after) == differences(p, *after));
+
+        for (auto reply : after->legal_moves()) {
+            auto next = after->apply_move(reply);
+            CHECK(next->bitmap() == (occupied(*next, IsWhite) | occupied(*next, IsBlack)));
+            CHECK(p.difference_bitmap(*next) == differences(p, *next));
+        }
+    }
+}
+
+TEST_CASE("read_move index agrees with linear scan") {
+    Position p{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"};
+
+    auto linear = [&p](Bitmap boardstate) {
+        auto maybe_valid = false;
+        for (auto move : p.legal_moves()) {
+            const auto after = p.apply_move(move);
+            maybe_valid = maybe_valid ||
+                after->bitmap() == boardstate ||
+                p.incomplete(boardstate, *after);
+        }
+        return maybe_valid;
+    };
+
+    // All boardstates with up to two squares changed
+    MoveList candidates;
+    for (auto a = a8; a <= h1; ++a) {
+        for (auto b = a; b <= h1; ++b) {
+            const auto boardstate = p.bitmap() ^ place(0, a) ^ (a != b ? place(0, b) : 0);
+            CHECK(p.read_move(boardstate, ActionHistory{}, candidates) == linear(boardstate));
+        }
+    }
+
+    // Each non-capturing move is recognized
+    for (auto move : p.legal_moves()) {
+        if (!move.is_capture()) {
+            CHECK(p.read_move(p.apply_move(move)->bitmap(), ActionHistory{}, candidates));
+            CHECK(!candidates.empty());
+            CHECK(candidates.front().src == move.src);
+            CHECK(candidates.front().dst == move.dst);
+        }
+    }
+}
+
+TEST_CASE("position tree records moves played") {
+    Game g;
+    const auto start = g.current();
+
+    g.play_san_move("e4");
+    const auto e4 = g.current();
+    g.play_takeback();
+    g.play_san_move("d4");
+    const auto d4 = g.current();
+    g.play_takeback();
+
+    // Main line first, then variations, sharing resulting positions
+    auto played = start->moves_played();
+    REQUIRE(played.size() == 2);
+    CHECK(played[0].second == e4);
+    CHECK(played[1].second == d4);
+    CHECK(start->move_played(played[0].first) == e4);
+    CHECK(start->find_move_played(d4) == played[1].first);
+
+    g.play_san_move("e4");
+    CHECK(g.current() == e4);
+
+    // Removing unlinks, remaining order is preserved
+    start->remove_move_played(played[0].first);
+    played = start->moves_played();
+    REQUIRE(played.size() == 1);
+    CHECK(played[0].second == d4);
+    CHECK(!start->move_played(start->uci_move("e2e4")));
+
+    // Positions outlive game
+    g.clear();
+    CHECK(e4->fen() == "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+}
+
+TEST_CASE("replaying edits restores game") {
+    Game g;
+    g.play_san_move("e4");
+    g.play_san_move("e5");
+    const auto pgn = g.pgn();
+    const auto fen = g.fen();
+    g.edits.clear();
+
+    // Variation, takeback, and a revised move (castling rook first)
+    g.play_san_move("Nf3");
+    g.play_takeback();
+    g.play_san_move("Bc4");
+    g.play_san_move("Nc6");
+    g.play_san_move("Nf3");
+    g.play_san_move("Nf6");
+    const auto rook = g.uci_move("h1f1");
+    g.play_move(rook);
+    g.revise_move(rook, g.previous()->uci_move("e1g1"));
+    REQUIRE(g.edits.size() == 10);
+    CHECK(g.edits[7].kind == GameEdit::TAKEBACK);
+    CHECK(g.edits[8].kind == GameEdit::REMOVE);
+
+    Game restored{pgn, fen};
+    restored.edits.clear();
+    for (const auto& edit : g.edits) {
+        restored.apply_edit(edit);
+    }
+    CHECK(restored.pgn() == g.pgn());
+    CHECK(restored.fen() == g.fen());
+    CHECK(restored.edits.size() == g.edits.size());
+}
@@ -0,0 +1,138 @@
+#include "../src/image.h"
+#include "doctest.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include <png.h>
+
+using namespace std;
+
+// Decode 1-bpp grayscale PNG with libpng, back into an image
+static bool decode(const vector<uint8_t>& png, Image& image) {
+    png_image decoded{};
+    decoded.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_memory(&decoded, png.data(), png.size())) {
+        return false;
+    }
+    if (int(decoded.width) != image.width || int(decoded.height) != image.height) {
+        png_image_free(&decoded);
+        return false;
+    }
+
+    decoded.format = PNG_FORMAT_GRAY;
+    vector<uint8_t> pixels(PNG_IMAGE_SIZE(decoded));
+    if (!png_image_finish_read(&decoded, NULL, pixels.data(), 0, NULL)) {
+        return false;
+    }
+
+    fill(image.data_.begin(), image.data_.end(), 0);
+    for (auto y = 0; y < image.height; ++y) {
+        for (auto x = 0; x < image.width; ++x) {
+            if (pixels[y * image.width + x]) {
+                image.data_[y * image.width_bytes + x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+    }
+    return true;
+}
+
+static vector<uint8_t> encode(const Image& image) {
+    vector<uint8_t> png(image.png_bound());
+    png.resize(image.png(png.data(), png.size()));
+    return png;
+}
+
+TEST_CASE("png round trip") {
+    Image image{128, 296};
+
+    SUBCASE("blank") {
+        fill(image.data_.begin(), image.data_.end(), 0xff);
+    }
+
+    SUBCASE("stripes and runs") {
+        for (auto y = 0; y < image.height; ++y) {
+            for (auto x = 0; x < image.width_bytes; ++x) {
+                image.data_[y * image.width_bytes + x] = (y / 16 + x / 2) % 2 ? 0xaa >> (y % 2) : 0xff;
+            }
+        }
+    }
+
+    SUBCASE("noise, stored uncompressed") {
+        srand(1);
+        for (auto& byte : image.data_) {
+            byte = rand();
+        }
+    }
+
+    const auto png = encode(image);
+    REQUIRE(!png.empty());
+    CHECK(png.size() <= image.png_bound());
+
+    Image decoded{image.width, image.height};
+    REQUIRE(decode(png, decoded));
+    CHECK(decoded == image);
+}
+
+TEST_CASE("png odd width") {
+    Image image{13, 5};
+    for (auto i = 0; i < image.size_bytes; ++i) {
+        image.data_[i] = i % 3 ? 0xff : 0x5a;
+    }
+    // Padding bits are not part of the image
+    for (auto y = 0; y < image.height; ++y) {
+        image.data_[y * image.width_bytes + 1] |= 0x07;
+    }
+
+    const auto png = encode(image);
+    Image decoded{image.width, image.height};
+    REQUIRE(decode(png, decoded));
+    for (auto y = 0; y < image.height; ++y) {
+        decoded.data_[y * image.width_bytes + 1] |= 0x07;
+    }
+    CHECK(decoded == image);
+}
+
+TEST_CASE("png odd sizes") {
+    // Sparse pixels, so that rows are compressed rather than stored
+    srand(2);
+    auto check_size = [](int width, int height) {
+        Image image{width, height};
+        for (auto y = 0; y < height; ++y) {
+            for (auto x = 0; x < width; ++x) {
+                if (rand() % 8 == 0) {
+                    image.data_[y * image.width_bytes + x / 8] |= 0x80 >> (x % 8);
+                }
+            }
+        }
+
+        const auto png = encode(image);
+        REQUIRE(!png.empty());
+        Image decoded{width, height};
+        REQUIRE(decode(png, decoded));
+        CHECK(decoded == image);
+    };
+
+    for (auto i = 0; i < 200; ++i) {
+        check_size(1 + rand() % 300, 1 + rand() % 40);
+    }
+
+    // Rows repeating 32 rows above, but too far apart to refer back to
+    Image wide{9000, 40};
+    for (auto y = 0; y < wide.height; ++y) {
+        for (auto x = 0; x < wide.width_bytes; ++x) {
+            wide.data_[y * wide.width_bytes + x] = (y % 32 + x) % 64 ? 0 : 0xf0;
+        }
+    }
+    const auto png = encode(wide);
+    Image decoded{wide.width, wide.height};
+    REQUIRE(decode(png, decoded));
+    CHECK(decoded == wide);
+    CHECK(png.size() < wide.png_bound() / 2);
+}
+
+TEST_CASE("png buffer too small") {
+    Image image{128, 296};
+    vector<uint8_t> png(image.png_bound() - 1);
+    CHECK(image.png(png.data(), png.size()) == 0);
+}
@@ -1,4 +1,5 @@
 #include "../src/chess/chess_game.h"
+#include "../src/chess/chess_pgn.h"
 #include "doctest.h"
 
 #include <cstdarg>
@@ -55,3 +56,83 @@ TEST_CASE("Steinitz") {
     g2.pgn(g1.pgn());
     CHECK(short_pgn(g2) == "1. e4 e5 2. Nf3 Nc6 3. Bb5 d6 4. d4");
 }
+
+TEST_CASE("comments, NAGs and results") {
+    Game g;
+    g.pgn(
+        "[Event \"Test \\\"quoted\\\"\"]\n"
+        "[Result \"*\"]\n"
+        "\n"
+        "% escaped line\n"
+        "1. e4 {best by test} e5 $1 2. Nf3! Nc6?! ; rest of line\n"
+        "3. Bb5 (3. Bc4 Bc5 (3... Nf6)) a6 1-0\n");
+    CHECK(g.tags["Event"] == "Test \"quoted\"");
+    CHECK(g.tags["Result"] == "1-0");
+    CHECK(short_pgn(g) == "1. e4 e5 2. Nf3 Nc6 3. Bb5 (3. Bc4 Bc5 (3... Nf6) ) 3... a6");
+    CHECK(g.fen() == "r1bqkbnr/1ppp1ppp/p1n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 0 4");
+}
+
+TEST_CASE("read multiple games") {
+    const string_view input =
+        "[Event \"One\"]\n\n1. f3 e6 2. g4 Qh4# 0-1\n\n"
+        "[Event \"Two\"]\n\n1. d4 d5 1/2-1/2\n"
+        "[Event \"Three\"]\n[FEN \"8/8/8/8/4k3/8/4p3/4K3 w - - 0 1\"]\n\n1. Kxe2\n";
+
+    auto pgn = input;
+    Game g;
+    REQUIRE(pgn::read_pgn(pgn, g));
+    CHECK(g.tags["Event"] == "One");
+    CHECK(g.tags["Result"] == "0-1");
+    CHECK(g.history.size() == 5);
+
+    REQUIRE(pgn::read_pgn(pgn, g));
+    CHECK(g.tags["Event"] == "Two");
+    CHECK(g.history.size() == 3);
+
+    // No result, game ends at end of input
+    REQUIRE(pgn::read_pgn(pgn, g));
+    CHECK(g.tags["Event"] == "Three");
+    CHECK(g.fen() == "8/8/8/8/4k3/8/4K3/8 b - - 0 1");
+    CHECK(pgn.empty());
+}
+
+TEST_CASE("reject malformed movetext") {
+    Game g;
+    CHECK_THROWS(g.pgn("1. e4 e5 2. Ke3"));
+    CHECK_THROWS(g.pgn("1. e4 (1. d4"));
+    CHECK_THROWS(g.pgn("1. e4 e5)"));
+    CHECK_THROWS(g.pgn("1. e4 {unterminated"));
+}
+
+TEST_CASE("non-ASCII and NUL bytes") {
+    Game g;
+    g.pgn(
+        "[White \"Nepomniachtchi, Ян\"]\n"
+        "[Black \"Bárány\"]\n"
+        "\n"
+        "1. e4 {Élan, ¡olé!} e5 *\n");
+    CHECK(g.tags["White"] == "Nepomniachtchi, Ян");
+    CHECK(g.tags["Black"] == "Bárány");
+    CHECK(g.history.size() == 3);
+
+    // Bytes outside ASCII, or NUL, don't continue a move
+    const char input[] = "e4\0e5 Nf3\xc3\xa9";
+    pgn::Tokenizer tokens{string_view{input, sizeof input - 1}};
+    REQUIRE(tokens.next() == pgn::Token::SAN);
+    CHECK(tokens.text == "e4");
+    CHECK(tokens.next() == pgn::Token::ERROR);
+    tokens.rest.remove_prefix(1);
+    REQUIRE(tokens.next() == pgn::Token::SAN);
+    CHECK(tokens.text == "e5");
+    REQUIRE(tokens.next() == pgn::Token::SAN);
+    CHECK(tokens.text == "Nf3");
+    CHECK(tokens.next() == pgn::Token::ERROR);
+}
+
+TEST_CASE("restore position after castling") {
+    // As when loading a saved game, current position is identified by FEN
+    Game g1{"1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 d6 8. c3 O-O"};
+    Game g2{g1.pgn(), g1.fen()};
+    CHECK(g2.history.size() == g1.history.size());
+    CHECK(g2.fen() == g1.fen());
+}
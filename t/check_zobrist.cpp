@@ -0,0 +1,95 @@
+#include "../src/chess/chess_game.h"
+#include "../src/thc/zobrist.h"
+#include "doctest.h"
+
+using namespace std;
+using namespace thc;
+
+// Verify incrementally updated hash against hash computed from scratch
+static void walk(const ChessPosition& position, int depth) {
+    if (position.key != zobrist::hash(position)) {
+        INFO(position.fen());
+        CHECK(position.key == zobrist::hash(position));
+    }
+    if (depth > 0) {
+        for (const auto& move : position.legal_moves()) {
+            walk(position.play_move(move), depth - 1);
+        }
+    }
+}
+
+TEST_CASE("zobrist incremental update") {
+    walk(ChessPosition{}, 3);
+    walk(Position{"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"}, 2);
+    walk(Position{"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"}, 3);
+    walk(Position{"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"}, 2);
+}
+
+TEST_CASE("zobrist transposition") {
+    ChessPosition p;
+    auto a = p.play_san_move("Nf3").play_san_move("Nf6").play_san_move("Nc3");
+    auto b = p.play_san_move("Nc3").play_san_move("Nf6").play_san_move("Nf3");
+    CHECK(a.key == b.key);
+    CHECK(a.key != p.play_san_move("Nc3").key);
+}
+
+TEST_CASE("zobrist ignores unusable en passant target") {
+    // No black pawn can capture on e3
+    auto e4 = ChessPosition{}.play_san_move("e4");
+    CHECK(e4.key == Position{"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1"}.key);
+
+    // But here d4 can capture on e3
+    auto exd = Position{"rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 3"};
+    CHECK(exd.key != Position{"rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 3"}.key);
+}
+
+TEST_CASE("repetition count") {
+    Game g;
+    CHECK(g.GetRepetitionCount() == 1);
+
+    for (auto i = 2; i <= 3; ++i) {
+        g.play_san_move("Nf3");
+        g.play_san_move("Nf6");
+        g.play_san_move("Ng1");
+        g.play_san_move("Ng8");
+        CHECK(g.GetRepetitionCount() == i);
+    }
+
+    // Same pieces, but castling rights lost
+    g.play_san_move("e4");
+    g.play_san_move("e5");
+    CHECK(g.GetRepetitionCount() == 1);
+    g.play_san_move("Ke2");
+    g.play_san_move("Ke7");
+    g.play_san_move("Ke1");
+    g.play_san_move("Ke8");
+    CHECK(g.GetRepetitionCount() == 1);
+}
+
+TEST_CASE("threefold repetition") {
+    Game g;
+    DRAWTYPE draw;
+
+    // The starting position occurs once, then twice, neither is a draw
+    const char* shuffle[] = {"Nf3", "Nf6", "Ng1", "Ng8"};
+    for (auto san : shuffle) {
+        CHECK(!g.IsDraw(true, draw));
+        g.play_san_move(san);
+    }
+    CHECK(g.GetRepetitionCount() == 2);
+    CHECK(!g.IsDraw(true, draw));
+    CHECK(draw == NOT_DRAW);
+
+    // Repeated with the other side to move, still only twice each
+    g.play_san_move("Nf3");
+    CHECK(g.GetRepetitionCount() == 2);
+    CHECK(!g.IsDraw(true, draw));
+
+    // Third occurrence of the starting position
+    g.play_san_move("Nf6");
+    g.play_san_move("Ng1");
+    g.play_san_move("Ng8");
+    CHECK(g.GetRepetitionCount() == 3);
+    CHECK(g.IsDraw(true, draw));
+    CHECK(draw == DRAWTYPE_REPITITION);
+}